@@ -0,0 +1,90 @@
+#pragma once
+#include <vector>
+
+using namespace std;
+
+/*
+	Column holds one field of a reference store, one value per target
+
+	Values are either owned, appended while parsing the source files, or viewed in place in memory the column does not
+	own, such as a section of a memory mapped reference index. The owner of viewed memory must keep it alive as long
+	as the column is used.
+*/
+template <typename T>
+class Column
+{
+	public:
+		/* function to reserve space for a number of owned values */
+		void reserve(unsigned long n) { values.reserve(n); items = values.data(); }
+
+		/* function to append an owned value */
+		void push_back(const T &value)
+		{
+			values.push_back(value);
+			items = values.data();
+			count = values.size();
+		}
+
+		/* function to take over the values of a vector as owned values, the vector is left with the previous ones */
+		void assign(vector<T> &owned)
+		{
+			values.swap(owned);
+			items = values.data();
+			count = values.size();
+		}
+
+		/* function to append the values of another column as owned values */
+		void append(const Column &other)
+		{
+			values.insert(values.end(), other.data(), other.data() + other.size());
+			items = values.data();
+			count = values.size();
+		}
+
+		/* function to resize the owned values, new values are zero */
+		void resize(unsigned long n)
+		{
+			values.resize(n);
+			items = values.data();
+			count = n;
+		}
+
+		/* function to overwrite an owned value, safe from several threads for distinct indexes */
+		void set(unsigned long index, const T &value) { values[index] = value; }
+
+		/* function to view count values in memory owned elsewhere, dropping any owned values */
+		void attach(const T *data, unsigned long n)
+		{
+			vector<T>().swap(values);
+			items = data;
+			count = n;
+		}
+
+		/* function to keep only the values in [first, last), owned values outside the range are freed */
+		void slice(unsigned long first, unsigned long last)
+		{
+			if (!values.empty())
+			{
+				vector<T>(values.begin() + first, values.begin() + last).swap(values);
+				items = values.data();
+			}
+			else
+			{
+				items += first;
+			}
+			count = last - first;
+		}
+
+		/* returns the number of values */
+		unsigned long size() const { return count; }
+
+		/* returns the values as a contiguous array */
+		const T *data() const { return items; }
+
+		const T &operator[](unsigned long index) const { return items[index]; }
+
+	private:
+		vector<T> values;
+		const T *items = nullptr;
+		unsigned long count = 0;
+};
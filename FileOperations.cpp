@@ -1,23 +1,94 @@
 #include "FileOperations.h"
 
+/* returns the end of the line starting at line, excluding the newline and any carriage return */
+static inline const char *getLineEnd(const char *line, const char *end)
+{
+	const char *lineEnd = line < end ? (const char *)memchr(line, '\n', end - line) : nullptr;
+	lineEnd = lineEnd == nullptr ? end : lineEnd;
+	return lineEnd > line && lineEnd[-1] == '\r' ? lineEnd - 1 : lineEnd;
+}
+
+/* returns the start of the line after the one starting at line */
+static inline const char *nextLine(const char *line, const char *end)
+{
+	const char *newline = line < end ? (const char *)memchr(line, '\n', end - line) : nullptr;
+	return newline == nullptr ? end : newline + 1;
+}
+
+/* returns the comma ending the field starting at field, or lineEnd for the last field */
+static inline const char *getFieldEnd(const char *field, const char *lineEnd)
+{
+	const char *comma = field < lineEnd ? (const char *)memchr(field, ',', lineEnd - field) : nullptr;
+	return comma == nullptr ? lineEnd : comma;
+}
+
+/* parses a signed decimal integer in place, leading blanks are skipped and parsing stops at the first non-digit */
+static inline long long parseInteger(const char *p, const char *end)
+{
+	long long value = 0;
+	bool negative = false;
+	while (p < end && (*p == ' ' || *p == '\t'))
+	{
+		p++;
+	}
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		value = value * 10 + (*p - '0');
+		p++;
+	}
+	return negative ? -value : value;
+}
+
+/* returns the number of target lines in whole lines of CSPR text, lines holding a '>' are chromosome headers */
+static unsigned long countCsprTargets(const char *begin, const char *end)
+{
+	unsigned long count = 0;
+	for (const char *line = begin; line < end; line = nextLine(line, end))
+	{
+		const char *lineEnd = getLineEnd(line, end);
+		if (lineEnd > line && memchr(line, '>', lineEnd - line) == nullptr)
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+/* runs work(c) for every chunk c, each chunk on its own thread */
+static void runChunks(unsigned long chunkCount, const function<void(unsigned long)> &work)
+{
+	vector<thread> threads;
+	for (unsigned long c = 1; c < chunkCount; c++)
+	{
+		threads.push_back(thread(work, c));
+	}
+	work(0);
+	for (unsigned long t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+}
+
 /*
-	functin for parsing CASPERinfo file to retrieve endo data and HSU matrix
+	function for parsing CASPERinfo file to retrieve only the endo data
 
 	@param casperInfoFilePath	=> file path to CASPERinfo
 	@param endo					=> name of endo being used
 	@param endoData				=> vector to hold endo data for OffTarget class
-	@param hsuMatrixName		=> name of HSU matrix to be loaded
-	@param hsuMatrix			=> map to hold the HSU matrix data for OffTarget class
 
  */
-void FileOperations::parseCasperInfo(string &casperInfoFilePath, string &endo, vector<int> &endoData, string &hsuMatrixName, map<string, vector<double>> &hsuMatrix)
+void FileOperations::parseEndoData(string &casperInfoFilePath, string &endo, vector<int> &endoData)
 {
 	/* vars */
 	ifstream casperInfoFile;
 	string line;
 	char endoDelimeter = ';';
-	double hsuVal = 0;
-	bool foundEndo, foundHsuMatrix = false;
+	bool foundEndo = false;
 
 	//open and confirm CASPERinfo opened
 	casperInfoFile.open(casperInfoFilePath);
@@ -40,26 +111,6 @@ void FileOperations::parseCasperInfo(string &casperInfoFilePath, string &endo, v
 				break;
 			}
 		}
-
-		//parse CASPERinfo for the HSU matrix data
-		casperInfoFile.seekg(SEEK_SET);
-		while (getline(casperInfoFile, line))
-		{
-			if (line.find(hsuMatrixName) != string::npos)
-			{
-				for (int i = 0; i < 12; i++)
-				{
-					getline(casperInfoFile, line);
-					stringstream ss(line);
-					while (ss >> hsuVal)
-					{
-						hsuMatrix[hsuKeys[i]].push_back(hsuVal);
-					}
-				}
-				foundHsuMatrix = true;
-				break;
-			}
-		}
 		casperInfoFile.close();
 	}
 	/* exit if CASPERinfo could not be found */
@@ -75,158 +126,563 @@ void FileOperations::parseCasperInfo(string &casperInfoFilePath, string &endo, v
 		cerr << "Endo information not found in CASPERinfo." << endl;
 		exit(-1);
 	}
+}
+
+/*
+	functin for parsing CASPERinfo file to retrieve endo data and HSU matrix
+
+	@param casperInfoFilePath	=> file path to CASPERinfo
+	@param endo					=> name of endo being used
+	@param endoData				=> vector to hold endo data for OffTarget class
+	@param hsuMatrixName		=> name of HSU matrix to be loaded
+	@param hsuMatrix			=> table compiled from the HSU matrix data for OffTarget class
+
+ */
+void FileOperations::parseCasperInfo(string &casperInfoFilePath, string &endo, vector<int> &endoData, string &hsuMatrixName, HsuMatrix &hsuMatrix)
+{
+	/* vars */
+	map<string, vector<double>> hsuRows;
+	ifstream casperInfoFile;
+	string line;
+	double hsuVal = 0;
+	bool foundHsuMatrix = false;
+
+	/* endo data first, exits if CASPERinfo or the endo can't be found */
+	parseEndoData(casperInfoFilePath, endo, endoData);
+
+	//open CASPERinfo and parse it for the HSU matrix data
+	casperInfoFile.open(casperInfoFilePath);
+	while (getline(casperInfoFile, line))
+	{
+		if (line.find(hsuMatrixName) != string::npos)
+		{
+			for (int i = 0; i < 12; i++)
+			{
+				getline(casperInfoFile, line);
+				stringstream ss(line);
+				while (ss >> hsuVal)
+				{
+					hsuRows[hsuKeys[i]].push_back(hsuVal);
+				}
+			}
+			foundHsuMatrix = true;
+			break;
+		}
+	}
+	casperInfoFile.close();
 
 	/* if HSU matrix specified couldn't be found, load the default setup */
 	if (foundHsuMatrix == false)
 	{
-		loadDefaultHsuMatrix(hsuMatrix);
+		loadDefaultHsuMatrix(hsuRows);
 	}
+
+	/* compile the HSU rows into a flat table covering every position of the sequence */
+	hsuMatrix.compile(hsuRows, endoData[4]);
 }
 
 /*
 	function for parsing organism CSPR file to retrieve the unique reference targets
 
-	@parma csprFilePath		=> file path to CSPR file
-	@param uniqueSeqs		=> concatenated string of all unqiue sequences in CSPR file
+	The file is mapped and parsed in place. Gzip compressed files, detected from their first bytes, are inflated in
+	batches of whole lines that are parsed while the next batch is inflated. When only a part of the targets is kept
+	they are counted in a first read of the file, which needs no memory, so that each part gets an equal share.
+
+	@parma csprFilePath		=> file path to CSPR file, plain text or gzip/BGZF compressed
+	@param uniqueSeqs		=> packed store of all unqiue sequences in CSPR file
 	@param uniqueScores		=> vector of ints holding the scores of each unqiue sequence
-	@param uniqueLocations	=> vector to store the locations of unique sequences
-	@param uniqueChroms		=> vector holding the chromosomes for the unqiues
+	@param uniqueLocations	=> chromosomes and locations of the unique sequences, kept as chromosome runs
+	@param threadCount		=> number of threads parsing chunks of the file
+	@param part				=> part of the targets kept, 0 for all of them
+	@param partCount		=> number of equal parts the targets are split into, 1 to keep all of them
  */
-void FileOperations::parseCsprFile(string &csprFilePath, string &uniqueSeqs, vector<uint8_t> &uniqueScores, vector <long long > &uniqueLocations, vector<int> &uniqueChroms)
+void FileOperations::parseCsprFile(string &csprFilePath, PackedSequences &uniqueSeqs, Column<uint8_t> &uniqueScores, LocationColumn &uniqueLocations, int threadCount, int part, int partCount)
 {
 	/* vars */
-	string line;
-	char csprFileDelimeter = ',';
+	MappedFile file;
 	int chromCount = 0;
+	int metaDataLines = 3;
+	unsigned long targetCount = 0;
+	unsigned long first = 0, last = ULONG_MAX;
+	bool counting = partCount > 1;
 
 	/* open and verify CSPR file */
-	ifstream file(csprFilePath);
-	if (file.is_open())
+	if (!file.open(csprFilePath))
 	{
+		cerr << "CSPR file could not be opened." << endl;
+		exit(-1);
+	}
+	uniqueLocations.init(true);
 
+	auto parseText = [&](const char *begin, const char *end)
+	{
 		/* ignore CSPR file meta data */
-		getline(file, line);
-		getline(file, line);
-		getline(file, line);
+		for (; metaDataLines > 0 && begin < end; metaDataLines--)
+		{
+			begin = nextLine(begin, end);
+		}
+		if (counting)
+		{
+			targetCount += countCsprTargets(begin, end);
+		}
+		else
+		{
+			parseCsprText(begin, end, uniqueSeqs, uniqueScores, uniqueLocations, threadCount, chromCount, targetCount, first, last);
+		}
+	};
+	auto readText = [&]()
+	{
+		if (GzipReader::isGzip(file.data(), file.size()))
+		{
+			if (!GzipReader::inflate(file.data(), file.size(), threadCount, parseText))
+			{
+				cerr << "CSPR file could not be decompressed." << endl;
+				exit(-1);
+			}
+		}
+		else
+		{
+			parseText(file.data(), file.data() + file.size());
+		}
+	};
+
+	/* the targets of the part are [first, last) of all the targets in file order */
+	if (counting)
+	{
+		readText();
+		getShardWindow(targetCount, part, partCount, first, last);
+		targetCount = 0;
+		metaDataLines = 3;
+		counting = false;
+	}
+	readText();
+}
 
-		/* loop through each line and extract the sequence data */
-		while (getline(file, line))
+/*
+	function for parsing whole lines of CSPR text and appending their targets to the stores
+
+	The text is split into one chunk of whole lines per thread. A first pass counts the targets and chromosome headers
+	of each chunk, which sizes the stores and gives each chunk the index of its first target and the chromosome it
+	starts in. The second pass parses every chunk's lines in place straight into the stores, and the location ranges
+	each chunk opens, and its sequences holding bases other than ACGT, are recorded in chunk order once every chunk is
+	parsed. Only the targets in [first, last) of the file are stored, each at its index in the file less first, and
+	chunks without any of them are skipped.
+
+	@param begin			=> first line to parse
+	@param end				=> end of the last line to parse
+	@param uniqueSeqs		=> packed store of all unqiue sequences in CSPR file
+	@param uniqueScores		=> vector of ints holding the scores of each unqiue sequence
+	@param uniqueLocations	=> chromosomes and locations of the unique sequences
+	@param threadCount		=> number of threads parsing chunks of the text
+	@param chromCount		=> chromosome headers seen before the text, updated with the headers in it
+	@param targetCount		=> targets seen before the text, updated with the targets in it
+	@param first			=> index in the file of the first target stored
+	@param last				=> index in the file after the last target stored
+ */
+void FileOperations::parseCsprText(const char *begin, const char *end, PackedSequences &uniqueSeqs, Column<uint8_t> &uniqueScores, LocationColumn &uniqueLocations, int threadCount, int &chromCount, unsigned long &targetCount, unsigned long first, unsigned long last)
+{
+	/* split the text into chunks of whole lines */
+	unsigned long chunkCount = max(1UL, min((unsigned long)max(1, threadCount), (unsigned long)(end - begin) / CSPR_MIN_CHUNK_SIZE));
+	vector<const char *> chunkStarts(chunkCount + 1, end);
+	chunkStarts[0] = begin;
+	for (unsigned long c = 1; c < chunkCount; c++)
+	{
+		const char *split = max(chunkStarts[c - 1], begin + (end - begin) * c / chunkCount);
+		chunkStarts[c] = split == begin ? begin : nextLine(split - 1, end);
+	}
+
+	/* first pass: targets and chromosome headers of each chunk */
+	vector<unsigned long> chunkTargets(chunkCount + 1, 0);
+	vector<int> chunkChroms(chunkCount + 1, 0);
+	runChunks(chunkCount, [&](unsigned long c)
+	{
+		for (const char *line = chunkStarts[c]; line < chunkStarts[c + 1]; line = nextLine(line, end))
 		{
-			if (line.find(">") == string::npos)
+			const char *lineEnd = getLineEnd(line, end);
+			if (lineEnd > line && memchr(line, '>', lineEnd - line) != nullptr)
 			{
-				vector<string> splitLine = split(line, csprFileDelimeter);
-				uniqueSeqs += splitLine[1];
-				uniqueScores.push_back(stoi(splitLine[3]));
-				uniqueLocations.push_back(stoll(splitLine[0]));
-				uniqueChroms.push_back(chromCount);
+				chunkChroms[c + 1]++;
 			}
-			else
+			else if (lineEnd > line)
 			{
-				chromCount++;
+				chunkTargets[c + 1]++;
 			}
 		}
+	});
+	chunkTargets[0] = targetCount;
+	chunkChroms[0] = chromCount;
+	for (unsigned long c = 1; c <= chunkCount; c++)
+	{
+		chunkTargets[c] += chunkTargets[c - 1];
+		chunkChroms[c] += chunkChroms[c - 1];
 	}
-	else
+	chromCount = chunkChroms[chunkCount];
+	targetCount = chunkTargets[chunkCount];
+
+	/* second pass: location,sequence,PAM,score lines parsed in place into the presized stores */
+	unsigned long storeSize = min(max(targetCount, first), last) - first;
+	uniqueSeqs.resize(storeSize);
+	uniqueScores.resize(storeSize);
+	uniqueLocations.resize(storeSize);
+	vector<vector<LocationRange> > chunkRanges(chunkCount);
+	vector<vector<pair<unsigned long, const char *> > > chunkAmbiguous(chunkCount);
+	runChunks(chunkCount, [&](unsigned long c)
 	{
-		cerr << "CSPR file could not be opened." << endl;
-		exit(-1);
+		unsigned long target = chunkTargets[c];
+		int chunkChromCount = chunkChroms[c];
+		if (chunkTargets[c + 1] <= first || target >= last)
+		{
+			return;
+		}
+		for (const char *line = chunkStarts[c]; line < chunkStarts[c + 1] && target < last; line = nextLine(line, end))
+		{
+			const char *lineEnd = getLineEnd(line, end);
+			if (lineEnd > line && memchr(line, '>', lineEnd - line) != nullptr)
+			{
+				chunkChromCount++;
+			}
+			else if (lineEnd > line)
+			{
+				if (target >= first)
+				{
+					const char *seqStart = getFieldEnd(line, lineEnd) + 1;
+					const char *seqEnd = getFieldEnd(min(seqStart, lineEnd), lineEnd);
+					const char *scoreStart = getFieldEnd(min(seqEnd + 1, lineEnd), lineEnd) + 1;
+					unsigned long index = target - first;
+					int seqLength = (int)max(0L, (long)(seqEnd - seqStart));
+					uniqueSeqs.set(index, seqStart, seqLength);
+					if (PackedSequences::isAmbiguous(seqStart, seqLength, uniqueSeqs.getSeqLength()))
+					{
+						chunkAmbiguous[c].push_back(make_pair(index, seqStart));
+					}
+					uniqueLocations.setOffset(index, LocationColumn::encode(index, chunkChromCount, parseInteger(line, lineEnd), chunkRanges[c]));
+					uniqueScores.set(index, (uint8_t)parseInteger(min(scoreStart, lineEnd), lineEnd));
+				}
+				target++;
+			}
+		}
+	});
+	for (unsigned long c = 0; c < chunkCount; c++)
+	{
+		uniqueLocations.appendRanges(chunkRanges[c]);
+		for (unsigned long a = 0; a < chunkAmbiguous[c].size(); a++)
+		{
+			const char *seq = chunkAmbiguous[c][a].second;
+			uniqueSeqs.addAmbiguous(chunkAmbiguous[c][a].first, seq, (int)(getFieldEnd(seq, getLineEnd(seq, end)) - seq));
+		}
 	}
 }
 
+/*
+	function to split the rowids of the repeats table into one range per thread, small tables are read by a single
+	connection
+
+	@parma dbFilePath	=> file path to DB file
+	@param threadCount	=> number of connections reading rowid ranges
+	@param rowidRanges	=> set to the ranges, without group counts
+ */
+void FileOperations::splitSqlRowids(string &dbFilePath, int threadCount, RepeatRowidRanges &rowidRanges)
+{
+	// the sql we will turn in to a prepared statement
+	string sql = "SELECT min(rowid), max(rowid) FROM repeats;";
+	sqlite3 *db = openSqlFile(dbFilePath);
+	sqlite3_stmt *pstmt = prepareSql(db, sql);
+	long long firstRowid = 0, lastRowid = -1;
+
+	// fetch the rowid range, both are NULL for an empty table
+	if (sqlite3_step(pstmt) == SQLITE_ROW && sqlite3_column_type(pstmt, 0) != SQLITE_NULL)
+	{
+		firstRowid = sqlite3_column_int64(pstmt, 0);
+		lastRowid = sqlite3_column_int64(pstmt, 1);
+	}
+	sqlite3_finalize(pstmt);
+	sqlite3_close_v2(db);
+
+	rowidRanges = RepeatRowidRanges();
+	if (lastRowid >= firstRowid)
+	{
+		rowidRanges.firstRowid = firstRowid;
+		rowidRanges.rowidCount = (unsigned long)(lastRowid - firstRowid) + 1;
+		rowidRanges.rangeCount = max(1UL, min((unsigned long)max(1, threadCount), rowidRanges.rowidCount / SQL_MIN_ROWIDS_PER_RANGE));
+	}
+}
+
+/*
+	function to split the rowids of the repeats table into ranges and count the seed groups of each range
+
+	The groups are counted in a read that stores nothing. Shard workers are given the counts by the process that
+	starts them, so the table is read once to find every shard's window of the groups rather than once per shard.
+
+	@parma dbFilePath	=> file path to DB file
+	@param threadCount	=> number of connections counting rowid ranges
+	@param rowidRanges	=> set to the ranges and the number of groups up to the end of each one
+ */
+void FileOperations::countSqlGroups(string &dbFilePath, int threadCount, RepeatRowidRanges &rowidRanges)
+{
+	splitSqlRowids(dbFilePath, threadCount, rowidRanges);
+	rowidRanges.groupEnds.assign(rowidRanges.rangeCount, 0);
+	runChunks(rowidRanges.rangeCount, [&](unsigned long r)
+	{
+		long long first, last;
+		PackedSequences seqs;
+		Column<uint8_t> scores;
+		LocationColumn locations;
+		Column<RepeatGroup> groups;
+		rowidRanges.getRowids(r, first, last);
+		rowidRanges.groupEnds[r] = parseSqlRange(dbFilePath, first, last, 0, 0, seqs, scores, locations, groups);
+	});
+	for (unsigned long r = 1; r < rowidRanges.rangeCount; r++)
+	{
+		rowidRanges.groupEnds[r] += rowidRanges.groupEnds[r - 1];
+	}
+}
 
 /*
 	function for parsing organism SQL file to retrieve the repeat reference targets
 
+	The rowids of the repeats table are split into one range per thread and each range is read by its own read-only
+	connection. Ranges are appended to the stores in rowid order, the order a single full table scan returns. The
+	repeats of a row share its seed and are recorded as a group so scans can rule them out together. When only a part
+	of the repeats is kept, the part keeps its window of the groups (getShardWindow), the same window a shard of a
+	fully loaded reference keeps, and only the rowid ranges overlapping the window are read. The groups of each range
+	are taken from countedRanges when they were counted beforehand, and counted here otherwise.
+
 	@parma dbFilePath		=> file path to DB file
-	@param repeatSeqs		=> concatenated string of all repeat sequences in CSPR file
+	@param repeatSeqs		=> packed store of all repeat sequences in DB file
 	@param repeatScores		=> vector of ints holding the scores of each repeat sequence
-	@param repeatLocations	=> vector to store the locations of repeats sequences
-	@param repeatChroms		=> vector holding the chromosomes for the repeats
+	@param repeatLocations	=> chromosomes and locations of the repeat sequences, one chromosome per repeat
+	@param repeatGroups		=> groups of consecutive repeats sharing a seed
+	@param threadCount		=> number of connections reading rowid ranges
+	@param part				=> part of the seed groups kept, 0 for all of them
+	@param partCount		=> number of equal parts the seed groups are split into, 1 to keep all of them
+	@param countedRanges	=> rowid ranges with their groups counted by countSqlGroups, null to split the rowids here
  */
-void FileOperations::parseSqlFile(string &dbFilePath, string &repeatSeqs, vector<uint8_t> &repeatScores, vector<long long> &repeatLocations, vector<int> &repeatChroms)
+void FileOperations::parseSqlFile(string &dbFilePath, PackedSequences &repeatSeqs, Column<uint8_t> &repeatScores, LocationColumn &repeatLocations, Column<RepeatGroup> &repeatGroups, int threadCount, int part, int partCount, const RepeatRowidRanges *countedRanges)
 {
-	// the sql we will turn in to a prepared statement
-	string sql = "SELECT seed, chromosome, location, three, five, score FROM repeats;";
-	sqlite3 *db; // pointer to our db
-	sqlite3_stmt *pstmt; // prepared statements corresponding to sql
-	string seed, chromosome, location, three, five, score;
-	char delimeter = ',';
-	char *zErrMsg = 0;
-	int rc; // return code from sqlite library
-
-	// open the database
-	rc = sqlite3_open_v2(dbFilePath.c_str(), &db, SQLITE_OPEN_READONLY, NULL);
-	if (rc)
+	/* vars */
+	RepeatRowidRanges rowidRanges;
+	unsigned long groupFirst = 0, groupLast = ULONG_MAX;
+	vector<unsigned long> ranges;
+
+	/* the repeats of a row are spread over chromosomes */
+	repeatLocations.init(false);
+
+	/* the groups of the part are [groupFirst, groupLast) of all the groups in rowid order */
+	if (partCount > 1)
 	{
-		fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
-		sqlite3_close_v2(db);
-		exit(-1);
+		if (countedRanges != nullptr)
+		{
+			rowidRanges = *countedRanges;
+		}
+		else
+		{
+			countSqlGroups(dbFilePath, threadCount, rowidRanges);
+		}
+		getShardWindow(rowidRanges.rangeCount > 0 ? rowidRanges.groupEnds[rowidRanges.rangeCount - 1] : 0, part, partCount, groupFirst, groupLast);
+	}
+	else
+	{
+		splitSqlRowids(dbFilePath, threadCount, rowidRanges);
+	}
+	for (unsigned long r = 0; r < rowidRanges.rangeCount && groupFirst < groupLast; r++)
+	{
+		if (partCount <= 1 || (groupFirst < rowidRanges.getGroupEnd(r) && groupLast > rowidRanges.getGroupFirst(r)))
+		{
+			ranges.push_back(r);
+		}
 	}
 
-	// create a prepared statement
-	rc = sqlite3_prepare_v3(db, sql.c_str(), -1, 0, &pstmt, NULL);
-	if (rc)
+	vector<PackedSequences> rangeSeqs(ranges.size());
+	vector<Column<uint8_t> > rangeScores(ranges.size());
+	vector<LocationColumn> rangeLocations(ranges.size());
+	vector<Column<RepeatGroup> > rangeGroups(ranges.size());
+	runChunks(ranges.size(), [&](unsigned long c)
 	{
-		fprintf(stderr, "Couldn't prepare sql statement: %s\n", sqlite3_errmsg(db));
-		sqlite3_finalize(pstmt);
-		sqlite3_close_v2(db);
-		exit(-1);
+		long long first, last;
+		unsigned long r = ranges[c], rangeGroupFirst = partCount > 1 ? rowidRanges.getGroupFirst(r) : 0;
+		rowidRanges.getRowids(r, first, last);
+		rangeSeqs[c].init(repeatSeqs.getSeqLength());
+		rangeLocations[c].init(false);
+		parseSqlRange(dbFilePath, first, last, groupFirst - min(groupFirst, rangeGroupFirst), groupLast - min(groupLast, rangeGroupFirst), rangeSeqs[c], rangeScores[c], rangeLocations[c], rangeGroups[c]);
+	});
+
+	/* concatenate the ranges in rowid order */
+	for (unsigned long c = 0; c < ranges.size(); c++)
+	{
+		for (unsigned long g = 0; g < rangeGroups[c].size(); g++)
+		{
+			RepeatGroup group = rangeGroups[c][g];
+			group.first += repeatSeqs.size();
+			repeatGroups.push_back(group);
+		}
+		repeatSeqs.append(rangeSeqs[c]);
+		repeatScores.append(rangeScores[c]);
+		repeatLocations.append(rangeLocations[c]);
 	}
+}
 
-	// fetch columns from our query
-	while (sqlite3_step(pstmt) == SQLITE_ROW)
+/*
+	function for parsing the repeats of the seed groups of a rowid range of the repeats table that fall in a window
+
+	Each row holds a seed and comma separated lists with one entry per repeat: chromosome, location, 3' and 5'
+	extensions and score. The lists are parsed in place from the column text without copying them into strings. The
+	groups of the range are numbered from 0 and only the repeats of groups in [groupFirst, groupLast) are stored, an
+	empty window counts the groups without storing anything.
+
+	@parma dbFilePath		=> file path to DB file
+	@param first			=> first rowid of the range
+	@param last				=> last rowid of the range
+	@param groupFirst		=> first group of the range stored
+	@param groupLast		=> group of the range one past the last one stored
+	@param repeatSeqs		=> packed store the repeat sequences of the range are appended to
+	@param repeatScores		=> scores of the repeats of the range
+	@param repeatLocations	=> chromosomes and locations of the repeats of the range
+	@param repeatGroups		=> groups of the repeats of the range, first is relative to the stored repeats
+
+	@return groupCount	=> number of groups of the range read, all of them unless the read stopped past the window
+ */
+unsigned long FileOperations::parseSqlRange(string &dbFilePath, long long first, long long last, unsigned long groupFirst, unsigned long groupLast, PackedSequences &repeatSeqs, Column<uint8_t> &repeatScores, LocationColumn &repeatLocations, Column<RepeatGroup> &repeatGroups)
+{
+	// the sql we will turn in to a prepared statement
+	string sql = "SELECT seed, chromosome, location, three, five, score FROM repeats WHERE rowid BETWEEN ? AND ?;";
+	sqlite3 *db = openSqlFile(dbFilePath);
+	sqlite3_stmt *pstmt = prepareSql(db, sql);
+	vector<char> seq;
+	unsigned long groupCount = 0;
+	bool counting = groupFirst >= groupLast;
+
+	sqlite3_bind_int64(pstmt, 1, first);
+	sqlite3_bind_int64(pstmt, 2, last);
+
+	// fetch columns from our query, every row starts a new group so the rows after the window are never read
+	while ((counting || groupCount < groupLast) && sqlite3_step(pstmt) == SQLITE_ROW)
 	{
-		seed = string(reinterpret_cast<const char*>(sqlite3_column_text(pstmt, 0)));
-		chromosome = string(reinterpret_cast<const char*>(sqlite3_column_text(pstmt, 1)));
-		location = string(reinterpret_cast<const char*>(sqlite3_column_text(pstmt, 2)));
-		three = string(reinterpret_cast<const char*>(sqlite3_column_text(pstmt, 3)));
-		five = string(reinterpret_cast<const char*>(sqlite3_column_text(pstmt, 4)));
-		score = string(reinterpret_cast<const char*>(sqlite3_column_text(pstmt, 5)));
+		const char *columns[6];
+		const char *columnEnds[6];
+		for (int c = 0; c < 6; c++)
+		{
+			const char *text = reinterpret_cast<const char*>(sqlite3_column_text(pstmt, c));
+			columns[c] = text == nullptr ? "" : text;
+			columnEnds[c] = columns[c] + sqlite3_column_bytes(pstmt, c);
+		}
+		const char *seed = columns[0], *chromosome = columns[1], *location = columns[2], *three = columns[3], *five = columns[4], *score = columns[5];
 
-		vector<string> chromosomeSplit = split(chromosome, delimeter);
-		vector<string> locationSplit = split(location, delimeter);
-		vector<string> threeSplit = split(three, delimeter);
-		vector<string> fiveSplit = split(five, delimeter);
-		vector<string> scoreSplit = split(score, delimeter);
+		/* checks for if repeat is 3'/5'/both, from whether the first entry of each list is empty */
+		bool hasThree = getFieldEnd(three, columnEnds[3]) != three;
+		bool hasFive = getFieldEnd(five, columnEnds[4]) != five;
+		if (!hasThree && !hasFive)
+		{
+			continue;
+		}
 
-		/* checks for if repeat is 3'/5'/both */
-		if (threeSplit[0] == "" && fiveSplit[0] != "")
+		/* one repeat per chromosome entry, the other lists are walked in step */
+		const char *chromosomeEnd = columnEnds[1];
+		bool firstRepeat = true, keep = false;
+		long lastSeedStart = 0;
+		while (true)
 		{
-			for (int i = 0; i < chromosomeSplit.size(); i++)
+			const char *chromosomeField = getFieldEnd(chromosome, chromosomeEnd);
+			const char *locationField = getFieldEnd(location, columnEnds[2]);
+			const char *threeField = getFieldEnd(three, columnEnds[3]);
+			const char *fiveField = getFieldEnd(five, columnEnds[4]);
+			const char *scoreField = getFieldEnd(score, columnEnds[5]);
+
+			/* a new group starts with each row, or where the seed moves because a 5' extension has another length */
+			long seedStart = hasFive ? (long)(fiveField - five) : 0;
+			long seedLength = (long)(columnEnds[0] - seed);
+			if (seedStart > 255 || seedLength > 255)
 			{
-				repeatSeqs += fiveSplit[i] + seed;
-				repeatChroms.push_back(stoi(chromosomeSplit[i]));
-				repeatLocations.push_back(stoll(locationSplit[i]));
-				repeatScores.push_back(stoi(scoreSplit[i]));
+				seedStart = seedLength = 0;
 			}
-		}
-		else if (threeSplit[0] != "" && fiveSplit[0] == "")
-		{
-			for (int i = 0; i < chromosomeSplit.size(); i++)
+			if (firstRepeat || lastSeedStart != seedStart)
 			{
-				repeatSeqs += seed + threeSplit[i];
-				repeatChroms.push_back(stoi(chromosomeSplit[i]));
-				repeatLocations.push_back(stoll(locationSplit[i]));
-				repeatScores.push_back(stoi(scoreSplit[i]));
+				keep = groupCount >= groupFirst && groupCount < groupLast;
+				if (keep)
+				{
+					RepeatGroup group = { repeatSeqs.size(), (uint8_t)seedStart, (uint8_t)seedLength };
+					repeatGroups.push_back(group);
+				}
+				groupCount++;
+				lastSeedStart = seedStart;
+				firstRepeat = false;
 			}
-		}
-		else if(threeSplit[0] != "" && fiveSplit[0] != "")
-		{
-			for (int i = 0; i < chromosomeSplit.size(); i++)
+
+			/* 5' extension + seed + 3' extension */
+			if (keep)
 			{
-				repeatSeqs += fiveSplit[i] + seed + threeSplit[i];
-				repeatChroms.push_back(stoi(chromosomeSplit[i]));
-				repeatLocations.push_back(stoll(locationSplit[i]));
-				repeatScores.push_back(stoi(scoreSplit[i]));
+				seq.clear();
+				if (hasFive)
+				{
+					seq.insert(seq.end(), five, fiveField);
+				}
+				seq.insert(seq.end(), seed, columnEnds[0]);
+				if (hasThree)
+				{
+					seq.insert(seq.end(), three, threeField);
+				}
+				repeatSeqs.appendChars(seq.data(), (int)seq.size());
+				repeatLocations.push_back((int)parseInteger(chromosome, chromosomeField), parseInteger(location, locationField));
+				repeatScores.push_back((uint8_t)parseInteger(score, scoreField));
 			}
-		}		
+
+			if (chromosomeField == chromosomeEnd)
+			{
+				break;
+			}
+			chromosome = chromosomeField + 1;
+			location = min(locationField + 1, columnEnds[2]);
+			three = min(threeField + 1, columnEnds[3]);
+			five = min(fiveField + 1, columnEnds[4]);
+			score = min(scoreField + 1, columnEnds[5]);
+		}
 	}
-	
-	// 5 close the prepared statement
-	sqlite3_finalize(pstmt);
 
-	// 6 close the database
+	// close the prepared statement and the database
+	sqlite3_finalize(pstmt);
 	sqlite3_close_v2(db);
+	return groupCount;
+}
+
+/*
+	function to open a read-only connection to the DB file, exits if it can't be opened
+
+	@param dbFilePath	=> file path to DB file
+
+	@return db	=> open connection
+ */
+sqlite3 *FileOperations::openSqlFile(string &dbFilePath)
+{
+	sqlite3 *db;
+	int rc = sqlite3_open_v2(dbFilePath.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL);
+	if (rc)
+	{
+		fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
+		sqlite3_close_v2(db);
+		exit(-1);
+	}
+	return db;
+}
+
+/*
+	function to create a prepared statement, exits if it can't be prepared
+
+	@param db	=> open connection
+	@param sql	=> statement to prepare
+
+	@return pstmt	=> prepared statement
+ */
+sqlite3_stmt *FileOperations::prepareSql(sqlite3 *db, string &sql)
+{
+	sqlite3_stmt *pstmt;
+	int rc = sqlite3_prepare_v3(db, sql.c_str(), -1, 0, &pstmt, NULL);
+	if (rc)
+	{
+		fprintf(stderr, "Couldn't prepare sql statement: %s\n", sqlite3_errmsg(db));
+		sqlite3_finalize(pstmt);
+		sqlite3_close_v2(db);
+		exit(-1);
+	}
+	return pstmt;
 }
 
 /*
@@ -300,44 +756,84 @@ void FileOperations::openOutputFile(string &outputFilePath, bool &avgOutput)
 }
 
 /*
-	function to write out the off target scoring results
+	function to format the off target scoring results of a query into the block written to the output file
+
+	Only reads its arguments, so worker threads can format their queries' blocks concurrently.
 
 	@param avgOutput		=> bool to determine if the output file will be in average format or detailed
 	@param querySeq			=> current query string to write results for
-	@param uniqueScores		=> scores of unqiue sequences
-	@param uniqueIndexes	=> indexes of the sequences found
-	@param repeatScores		=> scores of the repeat sequences
-	@param repeatIndexes	=> indexes of the repeats sequences found
-	@param repeatLocations	=> locations of the repeat sequences
-	@param repeatsChroms	=> chromosomes of the repeat sequences
-	@param repeatSeqs		=> repeat sequences found
-	@param uniqueLocations	=> locations of the unique sequences
-	@param uniqueChroms		=> chromosomes of the unqiue sequences
-	@param uniqueSeqs		=> unqiue sequences
-	@param seqLength		=> length of the pam
+	@param averageScore		=> average score of every hit reported for the query
+	@param hits				=> hits of the query, unique hits then repeat hits in reference order
+	@param repeatLocations	=> chromosomes and locations of the repeat sequences
+	@param repeatSeqs		=> packed repeat sequences
+	@param uniqueLocations	=> chromosomes and locations of the unique sequences
+	@param uniqueSeqs		=> packed unqiue sequences
+
+	@return block	=> output lines of the query
 */
-void FileOperations::writeResults(bool &avgOutput, string &querySeq, vector<double> &uniqueScores, vector<unsigned long> &uniqueIndexes, vector<double> &repeatScores, vector<unsigned long> &repeatIndexes, vector<long long> &repeatLocations, vector<int> &repeatChroms, string &repeatSeqs, vector<long long> &uniqueLocations, vector<int> &uniqueChroms, string &uniqueSeqs, int &seqLength)
+string FileOperations::formatResults(bool &avgOutput, string &querySeq, double averageScore, const HitList &hits, LocationColumn &repeatLocations, PackedSequences &repeatSeqs, LocationColumn &uniqueLocations, PackedSequences &uniqueSeqs)
 {
-    double averageScore = accumulate(uniqueScores.begin(), uniqueScores.end(), 0.0) + accumulate(repeatScores.begin(), repeatScores.end(), 0.0);
-        if (uniqueScores.size() + repeatScores.size() != 0)
-        {
-            averageScore /= (uniqueScores.size() + repeatScores.size());
-        }
-        outputFile << fixed;
-        outputFile << setprecision(6);
-        outputFile << querySeq << ":" << averageScore << endl;
+	ostringstream block;
+	block << fixed;
+	block << setprecision(6);
+	block << querySeq << ":" << averageScore << "\n";
 
 	if (avgOutput == false)
 	{
-		for (int i = 0; i < uniqueScores.size(); i++)
+		for (const HitChunk *chunk = hits.getFirstChunk(); chunk != nullptr; chunk = chunk->next)
 		{
-			outputFile <<uniqueScores[i] << "," << uniqueChroms[uniqueIndexes[i]] << "," << uniqueLocations[uniqueIndexes[i]] << "," << uniqueSeqs.substr(uniqueIndexes[i] * seqLength, seqLength) << endl;
+			for (int r = 0; r < chunk->count; r++)
+			{
+				const HitRecord &hit = chunk->records[r];
+				LocationColumn &locations = hit.source == 0 ? uniqueLocations : repeatLocations;
+				block << hit.score << "," << locations.getChrom(hit.index) << "," << locations.getLocation(hit.index) << "," << (hit.source == 0 ? uniqueSeqs : repeatSeqs).unpack(hit.index) << "\n";
+			}
 		}
-		for (int i = 0; i < repeatScores.size(); i++)
+	}
+	return block.str();
+}
+
+/*
+	function to format the off target scoring results of a query merged from shard workers, which send the rest of
+	each hit's output line after its score
+
+	@param avgOutput		=> bool to determine if the output file will be in average format or detailed
+	@param querySeq			=> current query string to write results for
+	@param averageScore		=> average score of every hit reported for the query
+	@param hits				=> hits of the query, unique hits then repeat hits, each indexing its line in lines[source]
+	@param lines			=> chromosome, location and sequence part of the output line of each unique and repeat hit
+
+	@return block	=> output lines of the query
+*/
+string FileOperations::formatMergedResults(bool &avgOutput, string &querySeq, double averageScore, const HitList &hits, vector<vector<string> > &lines)
+{
+	ostringstream block;
+	block << fixed;
+	block << setprecision(6);
+	block << querySeq << ":" << averageScore << "\n";
+
+	if (avgOutput == false)
+	{
+		for (const HitChunk *chunk = hits.getFirstChunk(); chunk != nullptr; chunk = chunk->next)
 		{
-			outputFile << repeatScores[i] << "," << repeatChroms[repeatIndexes[i]] << "," << repeatLocations[repeatIndexes[i]] << "," << repeatSeqs.substr(repeatIndexes[i] * seqLength, seqLength) << endl;
+			for (int r = 0; r < chunk->count; r++)
+			{
+				const HitRecord &hit = chunk->records[r];
+				block << hit.score << lines[hit.source][hit.index] << "\n";
+			}
 		}
 	}
+	return block.str();
+}
+
+/*
+	function to append formatted blocks to the output file
+
+	@param block	=> output lines to write
+*/
+void FileOperations::writeOutput(const string &block)
+{
+	outputFile.write(block.data(), block.size());
 }
 
 /*
@@ -356,7 +852,7 @@ void FileOperations::closeOutputFile()
 
 	@return splitStr	=> vector of substrings from split
  */
-vector<string> FileOperations::split(string s, char &delimiter)
+vector<string> FileOperations::split(string s, char delimiter)
 {
 	size_t pos = 0;
 	string token;
@@ -374,7 +870,7 @@ vector<string> FileOperations::split(string s, char &delimiter)
 /*
 	function to load the default HSU MATRIX-spCas9-2013
 
-	@param hsuMatrix	=> map to hold the HSU matrix data for OffTarget class
+	@param hsuMatrix	=> map to hold the HSU matrix rows before they are compiled into a table
 */
 void FileOperations::loadDefaultHsuMatrix(map<string, vector<double>> &hsuMatrix)
 {
@@ -6,23 +6,91 @@
 #include <map>
 #include <sstream>
 #include <cstdint>
+#include <climits>
 #include <numeric>
 #include <iomanip>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <thread>
 #include "sqlite3.h"
+#include "PackedSequences.h"
+#include "Column.h"
+#include "LocationColumn.h"
+#include "MappedFile.h"
+#include "GzipReader.h"
+#include "Score.h"
+#include "HitArena.h"
 
 using namespace std;
 
+/* CSPR files are split into at most one chunk per thread and at least this many bytes per chunk */
+const unsigned long CSPR_MIN_CHUNK_SIZE = 1UL << 20;
+
+/* the repeats table is split into at most one rowid range per thread and at least this many rowids per range */
+const unsigned long SQL_MIN_ROWIDS_PER_RANGE = 1UL << 14;
+
+/*
+	function to get the window of count items in reference order a shard keeps, used for both the unique targets and
+	the repeat seed groups by the parsers and by shards of a mapped or fully loaded reference, so they always agree
+
+	@param count	=> number of items split between the shards
+	@param part		=> index of the shard
+	@param partCount	=> number of shards
+	@param first	=> set to the index of the first item kept
+	@param last		=> set to the index one past the last item kept
+ */
+inline void getShardWindow(unsigned long count, int part, int partCount, unsigned long &first, unsigned long &last)
+{
+	first = count * part / partCount;
+	last = count * (part + 1) / partCount;
+}
+
+/*
+	RepeatRowidRanges splits the rowids of the repeats table into ranges read by their own connections
+	firstRowid	=> first rowid of the table
+	rowidCount	=> number of rowids from the first to the last one of the table
+	rangeCount	=> number of ranges, 0 for an empty table
+	groupEnds	=> number of seed groups in the ranges up to and including each one, empty unless they were counted
+*/
+struct RepeatRowidRanges
+{
+	long long firstRowid = 0;
+	unsigned long rowidCount = 0;
+	unsigned long rangeCount = 0;
+	vector<unsigned long> groupEnds;
+
+	/* function to get the first and last rowid of range r */
+	void getRowids(unsigned long r, long long &first, long long &last) const
+	{
+		first = firstRowid + (long long)(rowidCount * r / rangeCount);
+		last = firstRowid + (long long)(rowidCount * (r + 1) / rangeCount) - 1;
+	}
+
+	/* returns the index of the first seed group of range r */
+	unsigned long getGroupFirst(unsigned long r) const { return r > 0 ? groupEnds[r - 1] : 0; }
+
+	/* returns the index one past the last seed group of range r */
+	unsigned long getGroupEnd(unsigned long r) const { return groupEnds[r]; }
+};
+
 class FileOperations
 {
 	public:
+		/* function for parsing CASPERinfo file to retrieve only the endo data */
+		void parseEndoData(string &casperInfoFile, string &endo, vector<int> &endoData);
+
 		/* functin for parsing CASPERinfo file to retrieve endo data and HSU matrix */
-		void parseCasperInfo(string &casperInfoFile, string &endo, vector<int> &endoData, string &hsuMatrixName, map<string, vector<double>> &hsuMatrix);
+		void parseCasperInfo(string &casperInfoFile, string &endo, vector<int> &endoData, string &hsuMatrixName, HsuMatrix &hsuMatrix);
 		
 		/* function for parsing organism CSPR file to retrieve the unique reference targets */
-		void parseCsprFile(string &csprFilePath, string &uniqueSeqs, vector<uint8_t> &uniqueScores, vector<long long> &uniqueLocations, vector<int> &uniqueChroms);
+		void parseCsprFile(string &csprFilePath, PackedSequences &uniqueSeqs, Column<uint8_t> &uniqueScores, LocationColumn &uniqueLocations, int threadCount, int part, int partCount);
 
 		/* function for parsing organism SQL file to retrieve the repeat reference targets */
-		void parseSqlFile(string &dbFilePath, string &repeatSeqs, vector<uint8_t> &repeatScores, vector<long long> &repeatLocations, vector<int> &repeatChroms);
+		void parseSqlFile(string &dbFilePath, PackedSequences &repeatSeqs, Column<uint8_t> &repeatScores, LocationColumn &repeatLocations, Column<RepeatGroup> &repeatGroups, int threadCount, int part, int partCount, const RepeatRowidRanges *countedRanges);
+
+		/* function to split the rowids of the repeats table into ranges and count the seed groups of each one */
+		void countSqlGroups(string &dbFilePath, int threadCount, RepeatRowidRanges &rowidRanges);
 		
 		/* function for parsing the input query sequences to score */
 		void parseQueryFile(string &queryFilePath, string &querySeqs, vector<uint8_t> &queryScores);
@@ -33,8 +101,17 @@ class FileOperations
 		/* function to close output file */
 		void closeOutputFile();
 
-		/* function to write out the scoring results */
-		void writeResults(bool &avgOutput, string &querySeq, vector<double> &uniqueScores, vector<unsigned long> &uniqueIndexes, vector<double> &repeatScores, vector<unsigned long> &repeatIndexes, vector<long long> &repeatLocations, vector<int> &repeatChroms, string &repeatSeqs, vector<long long> &uniqueLocations, vector<int> &uniqueChroms, string &uniqueSeqs, int &seqLength);
+		/* function to format the scoring results of a query into the block written to the output file */
+		string formatResults(bool &avgOutput, string &querySeq, double averageScore, const HitList &hits, LocationColumn &repeatLocations, PackedSequences &repeatSeqs, LocationColumn &uniqueLocations, PackedSequences &uniqueSeqs);
+
+		/* function to format the scoring results of a query merged from shard workers */
+		string formatMergedResults(bool &avgOutput, string &querySeq, double averageScore, const HitList &hits, vector<vector<string> > &lines);
+
+		/* function to append formatted blocks to the output file */
+		void writeOutput(const string &block);
+
+		/* function split a given string based on a delimter */
+		static vector<string> split(string s, char delimiter);
 	
 	private:
 		ofstream outputFile;
@@ -42,8 +119,20 @@ class FileOperations
 		/* hsuKeys => static keys for the HSU matrix */
 		vector<string> hsuKeys = {"GT", "AC", "GG", "TG", "TT", "CA", "CT", "GA", "AA", "AG", "TC", "CC"};
 		
-		/* function split a given string based on a delimter */
-		vector<string> split(string s, char &delimiter);
+		/* function for parsing whole lines of CSPR text and appending their targets to the stores */
+		void parseCsprText(const char *begin, const char *end, PackedSequences &uniqueSeqs, Column<uint8_t> &uniqueScores, LocationColumn &uniqueLocations, int threadCount, int &chromCount, unsigned long &targetCount, unsigned long first, unsigned long last);
+
+		/* function to split the rowids of the repeats table into one range per thread */
+		void splitSqlRowids(string &dbFilePath, int threadCount, RepeatRowidRanges &rowidRanges);
+
+		/* function for parsing the repeats of the seed groups of a rowid range in a window, returns the groups of the range */
+		unsigned long parseSqlRange(string &dbFilePath, long long first, long long last, unsigned long groupFirst, unsigned long groupLast, PackedSequences &repeatSeqs, Column<uint8_t> &repeatScores, LocationColumn &repeatLocations, Column<RepeatGroup> &repeatGroups);
+
+		/* function to open a read-only connection to the DB file */
+		sqlite3 *openSqlFile(string &dbFilePath);
+
+		/* function to create a prepared statement */
+		sqlite3_stmt *prepareSql(sqlite3 *db, string &sql);
 
 		/* function to load the default HSU MATRIX-spCas9-2013 */
 		void loadDefaultHsuMatrix(map<string, vector<double>> &hsuMatrix);
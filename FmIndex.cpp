@@ -0,0 +1,211 @@
+#include "FmIndex.h"
+#include <algorithm>
+
+/* reads base j of a packed sequence of seqLength bases */
+static inline int getBase(const uint64_t *seq, int seqLength, int j)
+{
+	int r = seqLength - 1 - j;
+	return (int)((seq[r / 32] >> (2 * (r % 32))) & 3);
+}
+
+/*
+	function to build the index over a packed store
+
+	Only the order of the targets is carried through the columns: the bases of each column are read from the store
+	through the order into one byte per target, written into the rank blocks in one sequential pass and reordered by a
+	stable counting sort for the next column, so the packed words are never copied.
+
+	@param seqs				=> packed reference targets
+	@param length			=> length of the sequences
+	@param mismatches		=> max number of mismatches a hit may have
+ */
+void FmIndex::build(const PackedSequences &seqs, int length, int mismatches)
+{
+	/* target indexes are stored as 32-bit values */
+	if (seqs.size() >= UINT32_MAX)
+	{
+		return;
+	}
+
+	/* vars */
+	int wordsPerSeq = PackedSequences::wordsFor(length);
+	unsigned long count = seqs.size(), columnBlockCount = blocksFor(count);
+	vector<RankBlock> blockValues(columnBlockCount * length, RankBlock());
+	vector<uint32_t> startValues(4 * length, 0), orderValues(count), nextOrder(count);
+	vector<uint8_t> bases(count);
+
+	for (unsigned long i = 0; i < count; i++)
+	{
+		orderValues[i] = (uint32_t)i;
+	}
+
+	for (int column = 0; column < length; column++)
+	{
+		/* write the column's bases and the running counts of each base at the start of every block */
+		RankBlock *columnBlocks = &blockValues[column * columnBlockCount];
+		uint32_t counts[4] = { 0, 0, 0, 0 };
+		for (unsigned long i = 0; i < count; i++)
+		{
+			RankBlock &block = columnBlocks[i / 64];
+			if (i % 64 == 0)
+			{
+				copy(counts, counts + 4, block.counts);
+			}
+			int base = getBase(seqs.data() + (unsigned long)orderValues[i] * wordsPerSeq, length, column);
+			block.bases[(i % 64) / 32] |= (uint64_t)base << (2 * (i % 32));
+			bases[i] = (uint8_t)base;
+			counts[base]++;
+		}
+		if (count % 64 == 0)
+		{
+			copy(counts, counts + 4, columnBlocks[count / 64].counts);
+		}
+
+		/* stable counting sort on the column's bases gives the order of the next column */
+		uint32_t next[4];
+		for (int base = 0, start = 0; base < 4; start += counts[base], base++)
+		{
+			startValues[4 * column + base] = start;
+			next[base] = start;
+		}
+		for (unsigned long i = 0; i < count; i++)
+		{
+			nextOrder[next[bases[i]]++] = orderValues[i];
+		}
+		orderValues.swap(nextOrder);
+	}
+
+	seqLength = length;
+	maxMismatches = mismatches;
+	targetCount = count;
+	blocksPerColumn = columnBlockCount;
+	blocks.assign(blockValues);
+	starts.assign(startValues);
+	order.assign(orderValues);
+	setWindow(0, count);
+	built = true;
+}
+
+/*
+	function to view the tables of an index in memory owned elsewhere, such as sections of a mapped reference index,
+	dropping any owned tables
+
+	@param length		=> length of the sequences
+	@param count		=> number of targets
+	@param blockData	=> blocksFor(count) rank blocks of every column, column after column
+	@param startData	=> 4 starts of every column
+	@param orderData	=> count target indexes in the order after the last column
+	@param mismatches	=> max number of mismatches a hit may have
+ */
+void FmIndex::attach(int length, unsigned long count, const RankBlock *blockData, const uint32_t *startData, const uint32_t *orderData, int mismatches)
+{
+	seqLength = length;
+	maxMismatches = mismatches;
+	targetCount = count;
+	blocksPerColumn = blocksFor(count);
+	blocks.attach(blockData, blocksPerColumn * length);
+	starts.attach(startData, 4 * length);
+	order.attach(orderData, count);
+	setWindow(0, count);
+	built = true;
+}
+
+/*
+	function to only return the candidates in [first, last), rebased onto first, for an index over a whole reference
+	searched by a shard keeping a window of it
+
+	@param first	=> index of the first target returned
+	@param last		=> index one past the last target returned
+ */
+void FmIndex::setWindow(unsigned long first, unsigned long last)
+{
+	windowFirst = first;
+	windowLast = last;
+}
+
+/*
+	function to count the occurrences of each base in the first index entries of a column
+
+	@param column	=> column to count in
+	@param index	=> number of entries counted, at most the number of targets
+	@param counts	=> gets the occurrences of each base
+ */
+void FmIndex::rank(int column, uint32_t index, uint32_t *counts) const
+{
+	const RankBlock &block = blocks[column * blocksPerColumn + index / 64];
+	copy(block.counts, block.counts + 4, counts);
+	int remaining = index % 64;
+	for (int w = 0; w < 2 && remaining > 0; w++, remaining -= 32)
+	{
+		uint64_t used = remaining < 32 ? (1ULL << (2 * remaining)) - 1 : ~0ULL;
+		uint64_t low = block.bases[w] & 0x5555555555555555ULL & used, high = (block.bases[w] >> 1) & 0x5555555555555555ULL & used;
+		int lowCount = popCount64(low), highCount = popCount64(high), bothCount = popCount64(low & high);
+
+		/* T has both bits set, G only the high bit, C only the low bit and A neither */
+		counts[3] += bothCount;
+		counts[2] += highCount - bothCount;
+		counts[1] += lowCount - bothCount;
+		counts[0] += min(remaining, 32) - lowCount - highCount + bothCount;
+	}
+}
+
+/*
+	function to extend the matches of the query's first column bases by the base of the next column, trying the
+	query's base and, while the budget allows, the three others
+
+	@param querySeq		=> packed query sequence
+	@param column		=> next column to match
+	@param first		=> first entry of the interval of targets matching the query's first column bases
+	@param last			=> entry one past the interval
+	@param mismatches	=> mismatches spent on the first column bases
+	@param candidates	=> gets the targets of every interval that reaches the last column
+ */
+void FmIndex::search(const uint64_t *querySeq, int column, uint32_t first, uint32_t last, int mismatches, vector<unsigned long> &candidates) const
+{
+	if (column == seqLength)
+	{
+		candidates.insert(candidates.end(), order.data() + first, order.data() + last);
+		return;
+	}
+
+	/* vars */
+	int queryBase = getBase(querySeq, seqLength, column);
+	uint32_t firstCounts[4], lastCounts[4];
+	rank(column, first, firstCounts);
+	rank(column, last, lastCounts);
+
+	for (int base = 0; base < 4; base++)
+	{
+		int cost = mismatches + (base != queryBase ? 1 : 0);
+		if (cost <= maxMismatches && firstCounts[base] < lastCounts[base])
+		{
+			uint32_t start = starts[4 * column + base];
+			search(querySeq, column + 1, start + firstCounts[base], start + lastCounts[base], cost, candidates);
+		}
+	}
+}
+
+/*
+	function to collect the targets within maxMismatches of the query
+
+	@param querySeq		=> packed query sequence
+	@param candidates	=> filled with the matching target indexes of the window in ascending order
+ */
+void FmIndex::getCandidates(const uint64_t *querySeq, vector<unsigned long> &candidates) const
+{
+	candidates.clear();
+	if (targetCount > 0)
+	{
+		search(querySeq, 0, 0, (uint32_t)targetCount, 0, candidates);
+	}
+	sort(candidates.begin(), candidates.end());
+	if (windowFirst > 0 || windowLast < targetCount)
+	{
+		candidates.erase(lower_bound(candidates.begin(), candidates.end(), windowLast), candidates.end());
+		candidates.erase(candidates.begin(), lower_bound(candidates.begin(), candidates.end(), windowFirst));
+		for (unsigned long c = 0; c < candidates.size(); c++)
+		{
+			candidates[c] -= windowFirst;
+		}
+	}
+}
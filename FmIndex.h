@@ -0,0 +1,83 @@
+#pragma once
+#include "PackedSequences.h"
+#include "Column.h"
+
+/*
+	FmIndex is a positional Burrows-Wheeler transform of the reference targets, an FM-index over a collection of
+	sequences of equal length, searched with a mismatch budget by backtracking
+
+	Column k holds base k of every target, listed in the order of the targets sorted by their first k bases read from
+	base k - 1 back to base 0 (ties in store order). As in an FM-index, the targets whose first k + 1 bases match a
+	pattern form one interval of the order after column k, found from the interval after column k - 1 with two rank
+	queries of the pattern's base in column k (the LF mapping). Searching a query tries every base at every column and
+	abandons a branch once its mismatches exceed the budget or its interval is empty, so it only visits the prefixes of
+	the query within the budget that some target starts with. Every interval left after the last column holds targets
+	within the budget.
+
+	The tables are built once by OT index and written as sections of the reference index, so runs mapping the index only
+	view them in place. The index can be limited to a window of the targets, for a shard of a mapped reference.
+*/
+class FmIndex
+{
+	public:
+		/*
+			RankBlock holds 64 bases of a column and the count of each base in the column before them
+			counts	=> occurrences of each base in the column before the block
+			bases	=> 2-bit codes of the block's bases, base i at bit 2 * (i % 32) of word i / 32
+		*/
+		struct RankBlock
+		{
+			uint32_t counts[4];
+			uint64_t bases[2];
+		};
+
+		/* function to build the index over a packed store */
+		void build(const PackedSequences &seqs, int seqLength, int maxMismatches);
+
+		/* function to view the tables of an index in memory owned elsewhere */
+		void attach(int seqLength, unsigned long targetCount, const RankBlock *blockData, const uint32_t *startData, const uint32_t *orderData, int maxMismatches);
+
+		/* function to only return the candidates in [first, last), rebased onto first */
+		void setWindow(unsigned long first, unsigned long last);
+
+		/* function to collect the targets within maxMismatches of the query */
+		void getCandidates(const uint64_t *querySeq, vector<unsigned long> &candidates) const;
+
+		/* returns true once the index has been built or attached */
+		bool isBuilt() const { return built; }
+
+		/* returns the tables, written as sections of a reference index */
+		const Column<RankBlock> &getBlocks() const { return blocks; }
+		const Column<uint32_t> &getStarts() const { return starts; }
+		const Column<uint32_t> &getOrder() const { return order; }
+
+		/* returns the number of rank blocks of each column of an index over targetCount targets */
+		static unsigned long blocksFor(unsigned long targetCount) { return targetCount / 64 + 1; }
+
+	private:
+		/*
+			seqLength			=> number of columns
+			maxMismatches		=> mismatch budget of a search
+			targetCount			=> number of targets
+			blocksPerColumn		=> rank blocks of each column, one more than needed for targetCount bases
+			blocks				=> rank blocks of every column, column after column
+			starts				=> per column, number of bases of the column lower than each base
+			order				=> target indexes in the order after the last column
+			windowFirst/Last	=> targets returned as candidates
+		*/
+		bool built = false;
+		int seqLength = 0;
+		int maxMismatches = 0;
+		unsigned long targetCount = 0;
+		unsigned long blocksPerColumn = 0;
+		Column<RankBlock> blocks;
+		Column<uint32_t> starts;
+		Column<uint32_t> order;
+		unsigned long windowFirst = 0, windowLast = 0;
+
+		/* function to count the occurrences of each base in the first index entries of a column */
+		void rank(int column, uint32_t index, uint32_t *counts) const;
+
+		/* function to extend the matches of the query's first column bases by one column, depth first */
+		void search(const uint64_t *querySeq, int column, uint32_t first, uint32_t last, int mismatches, vector<unsigned long> &candidates) const;
+};
@@ -0,0 +1,311 @@
+#include "GzipReader.h"
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+/* largest input handed to zlib at once, its byte counts are 32-bit */
+static const uint64_t ZLIB_MAX_INPUT = 1UL << 30;
+
+/* reads a little endian 16-bit value */
+static inline uint32_t readLe16(const unsigned char *bytes)
+{
+	return bytes[0] | (bytes[1] << 8);
+}
+
+/* reads a little endian 32-bit value */
+static inline uint32_t readLe32(const unsigned char *bytes)
+{
+	return readLe16(bytes) | (readLe16(bytes + 2) << 16);
+}
+
+/*
+	function to check for the gzip magic bytes
+
+	@param data	=> start of the file
+	@param size	=> size of the file in bytes
+
+	@return true	=> the data is gzip compressed
+ */
+bool GzipReader::isGzip(const char *data, uint64_t size)
+{
+	return size >= 2 && (unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b;
+}
+
+/*
+	function to inflate gzip data, calling consumer with each batch of whole lines in order
+
+	@param data			=> start of the compressed file
+	@param size			=> size of the compressed file in bytes
+	@param threadCount	=> number of threads inflating BGZF blocks
+	@param consumer		=> called on the calling thread with the start and end of each batch, every batch but the last
+						   ends with a newline
+
+	@return true	=> the whole file was inflated and consumed
+	@return false	=> the data is corrupt or truncated, the batches before the error were consumed
+ */
+bool GzipReader::inflate(const char *data, uint64_t size, int threadCount, const function<void(const char *, const char *)> &consumer)
+{
+	/* vars */
+	vector<BgzfBlock> blocks;
+	bool bgzf = getBgzfBlocks(data, size, blocks);
+	mutex lock;
+	condition_variable changed;
+	deque<vector<char> > ready;
+	bool producerDone = false, failed = false;
+
+	/* the producer inflates the next batch while the consumer parses the current one */
+	thread producer([&]()
+	{
+		vector<char> carry;
+		bool ok = true, finished = false;
+		unsigned long nextBlock = 0;
+		uint64_t position = 0;
+		z_stream stream;
+
+		memset(&stream, 0, sizeof(stream));
+		if (!bgzf)
+		{
+			/* 15 + 32: largest window, gzip or zlib header detected automatically */
+			ok = inflateInit2(&stream, 15 + 32) == Z_OK;
+		}
+		while (ok && !finished)
+		{
+			vector<char> batch;
+			batch.swap(carry);
+			if (bgzf)
+			{
+				/* take whole blocks until the batch is full, at least one */
+				unsigned long lastBlock = nextBlock;
+				uint64_t batchSize = 0;
+				while (lastBlock < blocks.size() && (lastBlock == nextBlock || batchSize + blocks[lastBlock].size <= GZIP_BATCH_SIZE))
+				{
+					batchSize += blocks[lastBlock].size;
+					lastBlock++;
+				}
+				uint64_t start = batch.size();
+				batch.resize(start + batchSize);
+				ok = inflateBgzfBlocks(data, &blocks[nextBlock], lastBlock - nextBlock, threadCount, batch.data() + start);
+				nextBlock = lastBlock;
+				finished = nextBlock == blocks.size();
+			}
+			else
+			{
+				ok = inflateStream(stream, data, size, position, GZIP_BATCH_SIZE, batch, finished);
+			}
+
+			/* a partial last line moves on to the next batch */
+			if (ok && !finished)
+			{
+				vector<char>::reverse_iterator newline = find(batch.rbegin(), batch.rend(), '\n');
+				carry.assign(newline.base(), batch.end());
+				batch.resize(batch.size() - carry.size());
+			}
+			if (ok && !batch.empty())
+			{
+				unique_lock<mutex> guard(lock);
+				changed.wait(guard, [&ready]() { return ready.empty(); });
+				ready.push_back(move(batch));
+				changed.notify_all();
+			}
+		}
+		if (!bgzf)
+		{
+			inflateEnd(&stream);
+		}
+
+		lock_guard<mutex> guard(lock);
+		producerDone = true;
+		failed = !ok;
+		changed.notify_all();
+	});
+
+	while (true)
+	{
+		vector<char> batch;
+		{
+			unique_lock<mutex> guard(lock);
+			changed.wait(guard, [&ready, &producerDone]() { return !ready.empty() || producerDone; });
+			if (ready.empty())
+			{
+				break;
+			}
+			batch = move(ready.front());
+			ready.pop_front();
+			changed.notify_all();
+		}
+		consumer(batch.data(), batch.data() + batch.size());
+	}
+	producer.join();
+	return !failed;
+}
+
+/*
+	function to list the blocks of a BGZF file
+
+	Every BGZF block is a gzip member whose only header extra is the BC subfield holding the block's size, so the
+	blocks can be located from their headers without inflating anything.
+
+	@param data		=> start of the compressed file
+	@param size		=> size of the compressed file in bytes
+	@param blocks	=> filled with every block of the file
+
+	@return true	=> the file is a chain of BGZF blocks
+	@return false	=> the file is another kind of gzip file
+ */
+bool GzipReader::getBgzfBlocks(const char *data, uint64_t size, vector<BgzfBlock> &blocks)
+{
+	uint64_t offset = 0;
+	while (offset < size)
+	{
+		const unsigned char *header = (const unsigned char *)data + offset;
+		if (size - offset < 18 || header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 || header[3] != 4)
+		{
+			return false;
+		}
+		uint32_t extraLength = readLe16(header + 10);
+		uint64_t blockSize = 0;
+		for (uint32_t p = 12; p + 4 <= 12 + extraLength && 12 + extraLength <= size - offset; p += 4 + readLe16(header + p + 2))
+		{
+			if (header[p] == 'B' && header[p + 1] == 'C' && readLe16(header + p + 2) == 2)
+			{
+				blockSize = readLe16(header + p + 4) + 1;
+			}
+		}
+		if (blockSize < 12 + extraLength + 8 || blockSize > size - offset)
+		{
+			return false;
+		}
+
+		BgzfBlock block;
+		block.offset = offset + 12 + extraLength;
+		block.compressedSize = (uint32_t)(blockSize - 12 - extraLength - 8);
+		block.crc = readLe32(header + blockSize - 8);
+		block.size = readLe32(header + blockSize - 4);
+		blocks.push_back(block);
+		offset += blockSize;
+	}
+	return !blocks.empty();
+}
+
+/*
+	function to inflate a range of BGZF blocks in parallel into consecutive parts of output
+
+	@param data			=> start of the compressed file
+	@param blocks		=> first block to inflate
+	@param blockCount	=> number of blocks to inflate
+	@param threadCount	=> number of threads inflating blocks
+	@param output		=> room for the uncompressed size of every block
+
+	@return true	=> every block inflated to its recorded size and CRC
+ */
+bool GzipReader::inflateBgzfBlocks(const char *data, const BgzfBlock *blocks, unsigned long blockCount, int threadCount, char *output)
+{
+	/* vars */
+	vector<uint64_t> outputOffsets(blockCount + 1, 0);
+	atomic<unsigned long> nextBlock(0);
+	atomic<bool> ok(true);
+	vector<thread> threads;
+
+	for (unsigned long b = 0; b < blockCount; b++)
+	{
+		outputOffsets[b + 1] = outputOffsets[b] + blocks[b].size;
+	}
+
+	auto inflateBlocks = [&]()
+	{
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+
+		/* raw deflate, the gzip header and trailer were already read by getBgzfBlocks */
+		if (inflateInit2(&stream, -15) != Z_OK)
+		{
+			ok = false;
+			return;
+		}
+		for (unsigned long b = nextBlock++; b < blockCount && ok; b = nextBlock++)
+		{
+			char *blockOutput = output + outputOffsets[b];
+			inflateReset(&stream);
+			stream.next_in = (Bytef *)(data + blocks[b].offset);
+			stream.avail_in = blocks[b].compressedSize;
+			stream.next_out = (Bytef *)blockOutput;
+			stream.avail_out = blocks[b].size;
+			if (::inflate(&stream, Z_FINISH) != Z_STREAM_END || stream.avail_out != 0 || crc32(0, (const Bytef *)blockOutput, blocks[b].size) != blocks[b].crc)
+			{
+				ok = false;
+			}
+		}
+		inflateEnd(&stream);
+	};
+
+	for (unsigned long t = 1; t < min((unsigned long)max(1, threadCount), blockCount); t++)
+	{
+		threads.push_back(thread(inflateBlocks));
+	}
+	inflateBlocks();
+	for (unsigned long t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+	return ok;
+}
+
+/*
+	function to inflate the next part of a gzip stream, continuing into any following gzip members
+
+	@param stream	=> zlib stream initialized for gzip decoding, kept between calls
+	@param data		=> start of the compressed file
+	@param size		=> size of the compressed file in bytes
+	@param position	=> offset of the first byte of data not handed to zlib yet, kept between calls
+	@param maxBytes	=> most bytes appended to output
+	@param output	=> uncompressed bytes are appended to it
+	@param finished	=> set to true once the last member has been inflated
+
+	@return true	=> the bytes appended are valid, false for corrupt or truncated data
+ */
+bool GzipReader::inflateStream(z_stream &stream, const char *data, uint64_t size, uint64_t &position, uint64_t maxBytes, vector<char> &output, bool &finished)
+{
+	uint64_t start = output.size();
+	output.resize(start + maxBytes);
+	stream.next_out = (Bytef *)(output.data() + start);
+	stream.avail_out = (uInt)maxBytes;
+
+	while (stream.avail_out > 0)
+	{
+		if (stream.avail_in == 0)
+		{
+			/* out of input before the last member ended */
+			if (position == size)
+			{
+				return false;
+			}
+			uint64_t chunk = min(size - position, ZLIB_MAX_INPUT);
+			stream.next_in = (Bytef *)(data + position);
+			stream.avail_in = (uInt)chunk;
+			position += chunk;
+		}
+
+		int rc = ::inflate(&stream, Z_NO_FLUSH);
+		if (rc == Z_STREAM_END)
+		{
+			/* concatenated gzip files are one file, anything else after a member is ignored like gzip does */
+			uint64_t next = position - stream.avail_in;
+			if (!isGzip(data + next, size - next))
+			{
+				finished = true;
+				break;
+			}
+			inflateReset(&stream);
+		}
+		else if (rc != Z_OK && !(rc == Z_BUF_ERROR && stream.avail_in == 0))
+		{
+			return false;
+		}
+	}
+	output.resize(output.size() - stream.avail_out);
+	return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <zlib.h>
+
+using namespace std;
+
+/* uncompressed bytes handed to the consumer at a time, rounded to whole lines */
+const uint64_t GZIP_BATCH_SIZE = 16UL << 20;
+
+/*
+	GzipReader inflates gzip compressed text and hands it to a consumer in batches of whole lines
+
+	Inflation runs on its own thread and stays at most one batch ahead of the consumer, so inflating the next batch
+	overlaps with parsing the current one and memory stays bounded for any file size. BGZF files, a series of
+	independently compressed gzip blocks of at most 64 KB that record their compressed and uncompressed sizes, have the
+	blocks of each batch inflated in parallel. Any other gzip file, including concatenated members, is inflated as a
+	single stream.
+*/
+class GzipReader
+{
+	public:
+		/* returns true if the data starts with the gzip magic bytes */
+		static bool isGzip(const char *data, uint64_t size);
+
+		/* function to inflate gzip data, calling consumer with each batch of whole lines in order */
+		static bool inflate(const char *data, uint64_t size, int threadCount, const function<void(const char *, const char *)> &consumer);
+
+	private:
+		/*
+			BgzfBlock describes one BGZF block
+			offset			=> offset of the block's deflate data in the file
+			compressedSize	=> size of the deflate data
+			size			=> uncompressed size of the block
+			crc				=> CRC32 of the uncompressed block
+		*/
+		struct BgzfBlock
+		{
+			uint64_t offset;
+			uint32_t compressedSize;
+			uint32_t size;
+			uint32_t crc;
+		};
+
+		/* function to list the blocks of a BGZF file, returns false if the data isn't a chain of BGZF blocks */
+		static bool getBgzfBlocks(const char *data, uint64_t size, vector<BgzfBlock> &blocks);
+
+		/* function to inflate a range of BGZF blocks in parallel into consecutive parts of output */
+		static bool inflateBgzfBlocks(const char *data, const BgzfBlock *blocks, unsigned long blockCount, int threadCount, char *output);
+
+		/* function to inflate the next part of a gzip stream, continuing into following members, appending at most maxBytes to output */
+		static bool inflateStream(z_stream &stream, const char *data, uint64_t size, uint64_t &position, uint64_t maxBytes, vector<char> &output, bool &finished);
+};
@@ -0,0 +1,145 @@
+#include "HitArena.h"
+
+/*
+	function to take a free chunk, allocating a new slab of chunks if there is none
+
+	@return chunk	=> empty chunk owned by this arena
+ */
+HitChunk *HitArena::allocate()
+{
+	lock_guard<mutex> guard(lock);
+	if (freeChunks == nullptr)
+	{
+		HitChunk *slab = new HitChunk[HIT_CHUNKS_PER_SLAB];
+		slabs.push_back(unique_ptr<HitChunk[]>(slab));
+		for (int c = 0; c < HIT_CHUNKS_PER_SLAB; c++)
+		{
+			slab[c].arena = this;
+			slab[c].next = c + 1 < HIT_CHUNKS_PER_SLAB ? &slab[c + 1] : nullptr;
+		}
+		freeChunks = slab;
+	}
+	HitChunk *chunk = freeChunks;
+	freeChunks = chunk->next;
+	chunk->next = nullptr;
+	chunk->count = 0;
+	return chunk;
+}
+
+/*
+	function to return a chunk to the free list
+
+	@param chunk	=> chunk taken from this arena, no longer used by any list
+ */
+void HitArena::recycle(HitChunk *chunk)
+{
+	lock_guard<mutex> guard(lock);
+	chunk->next = freeChunks;
+	freeChunks = chunk;
+}
+
+/*
+	function to link a chunk at the end of the list
+
+	@param chunk	=> chunk to link, its records are counted by the caller
+ */
+void HitList::addChunk(HitChunk *chunk)
+{
+	if (last == nullptr)
+	{
+		first = chunk;
+	}
+	else
+	{
+		last->next = chunk;
+	}
+	last = chunk;
+}
+
+/*
+	function to move the records of another list to the end of this one, its chunks are linked without copying
+
+	@param other	=> list emptied into this one
+ */
+void HitList::splice(HitList &other)
+{
+	if (other.first == nullptr)
+	{
+		return;
+	}
+	addChunk(other.first);
+	last = other.last;
+	count += other.count;
+	other.first = other.last = nullptr;
+	other.count = 0;
+}
+
+/*
+	function to keep only the records whose flag is set, compacting them towards the front and returning the chunks
+	left empty
+
+	@param flags	=> one flag per record in list order
+ */
+void HitList::keep(const vector<bool> &flags)
+{
+	/* vars */
+	HitChunk *target = first;
+	int targetCount = 0;
+	unsigned long position = 0;
+
+	/* records are only written to chunks that have been read, the write position never passes the read position */
+	for (HitChunk *chunk = first; chunk != nullptr; chunk = chunk->next)
+	{
+		for (int r = 0; r < chunk->count; r++, position++)
+		{
+			if (!flags[position])
+			{
+				continue;
+			}
+			if (targetCount == HIT_CHUNK_SIZE)
+			{
+				target->count = HIT_CHUNK_SIZE;
+				target = target->next;
+				targetCount = 0;
+			}
+			target->records[targetCount++] = chunk->records[r];
+		}
+	}
+	if (targetCount == 0)
+	{
+		release();
+		return;
+	}
+
+	/* the records kept end in target, the chunks after it are returned */
+	HitChunk *rest = target->next;
+	target->count = targetCount;
+	target->next = nullptr;
+	last = target;
+	while (rest != nullptr)
+	{
+		HitChunk *next = rest->next;
+		rest->arena->recycle(rest);
+		rest = next;
+	}
+	count = 0;
+	for (HitChunk *chunk = first; chunk != nullptr; chunk = chunk->next)
+	{
+		count += chunk->count;
+	}
+}
+
+/*
+	function to return every chunk to the arena it was taken from and empty the list
+ */
+void HitList::release()
+{
+	while (first != nullptr)
+	{
+		HitChunk *next = first->next;
+		first->arena->recycle(first);
+		first = next;
+	}
+	last = nullptr;
+	count = 0;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+using namespace std;
+
+/* hit records per chunk, a chunk is a little over 4 KB */
+const int HIT_CHUNK_SIZE = 256;
+
+/* chunks allocated at once when an arena has no free chunk */
+const int HIT_CHUNKS_PER_SLAB = 16;
+
+/*
+	HitRecord is a hit found by a scan
+	score	=> off-target score of the hit
+	index	=> store index of the hit's target, or its position in the output lines of a shard merge
+	source	=> 0 for the unique store, 1 for the repeat store
+*/
+struct HitRecord
+{
+	double score;
+	uint64_t index : 63;
+	uint64_t source : 1;
+};
+
+class HitArena;
+
+/*
+	HitChunk holds consecutive records of a hit list
+	arena	=> arena the chunk is returned to
+	next	=> next chunk of the list, null for the last one
+	count	=> number of records used
+*/
+struct HitChunk
+{
+	HitArena *arena;
+	HitChunk *next;
+	int count;
+	HitRecord records[HIT_CHUNK_SIZE];
+};
+
+/*
+	HitArena hands out the chunks the hit lists of one worker grow by
+
+	Released chunks go back to the arena's free list and are reused by the next queries, so a run allocates about as
+	many chunks as its queries in flight hold at once. A list can be released on any thread, so the free list is
+	locked, but a worker only takes the lock once per chunk. The chunks are allocated in slabs and all of them are
+	freed together with the arena.
+*/
+class HitArena
+{
+	public:
+		/* function to take a free chunk, allocating a new slab if there is none */
+		HitChunk *allocate();
+
+		/* function to return a chunk to the free list, safe from any thread */
+		void recycle(HitChunk *chunk);
+
+	private:
+		/*
+			freeChunks	=> chunks not used by any list, linked through next
+			slabs		=> every chunk of the arena, freed with it
+		*/
+		mutex lock;
+		HitChunk *freeChunks = nullptr;
+		vector<unique_ptr<HitChunk[]> > slabs;
+};
+
+/*
+	HitList is a sequence of hit records kept in chunks taken from hit arenas
+
+	Appending never moves records, and the lists of several tasks are joined by linking their chunks. The records of
+	the list are read chunk by chunk from getFirstChunk.
+*/
+class HitList
+{
+	public:
+		HitList() {}
+		HitList(HitList &&other) noexcept : first(other.first), last(other.last), count(other.count) { other.first = other.last = nullptr; other.count = 0; }
+		HitList(const HitList &) = delete;
+		HitList &operator=(const HitList &) = delete;
+		~HitList() { release(); }
+
+		/* function to append a record, taking a new chunk from the arena when the last one is full */
+		void push_back(HitArena &arena, const HitRecord &record)
+		{
+			if (last == nullptr || last->count == HIT_CHUNK_SIZE)
+			{
+				addChunk(arena.allocate());
+			}
+			last->records[last->count++] = record;
+			count++;
+		}
+
+		/* function to move the records of another list to the end of this one */
+		void splice(HitList &other);
+
+		/* function to keep only the records whose flag is set, in their order */
+		void keep(const vector<bool> &flags);
+
+		/* function to return every chunk to its arena and empty the list */
+		void release();
+
+		/* returns the first chunk, null for an empty list */
+		const HitChunk *getFirstChunk() const { return first; }
+
+		/* returns the number of records */
+		unsigned long size() const { return count; }
+
+	private:
+		HitChunk *first = nullptr;
+		HitChunk *last = nullptr;
+		unsigned long count = 0;
+
+		/* function to link a chunk at the end of the list */
+		void addChunk(HitChunk *chunk);
+};
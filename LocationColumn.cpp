@@ -0,0 +1,177 @@
+#include "LocationColumn.h"
+#include <algorithm>
+#include <climits>
+
+/* width of the window of distances covered by a range, its base is a multiple of it */
+static const long long LOCATION_WINDOW = 1LL << 31;
+
+/* returns true if a target of chrom at distance can't be encoded against the range last */
+static inline bool opensRange(const LocationRange &last, int chrom, long long distance)
+{
+	return last.chrom != chrom || distance < last.base || distance - last.base > INT32_MAX;
+}
+
+/*
+	function to choose how chromosomes are stored and clear the column
+
+	@param chromosomeRuns	=> true to keep chromosomes in the range table, for targets sorted by chromosome
+ */
+void LocationColumn::init(bool chromosomeRuns)
+{
+	this->chromosomeRuns = chromosomeRuns;
+	offsets = Column<int32_t>();
+	ranges = Column<LocationRange>();
+	chroms = Column<int>();
+}
+
+/*
+	function to append the location of a target
+
+	@param chrom	=> chromosome of the target
+	@param location	=> location of the target, negative on the reverse strand
+ */
+void LocationColumn::push_back(int chrom, long long location)
+{
+	/* encoded against the last range directly, a range is only added when the target opens one */
+	int rangeChrom = chromosomeRuns ? chrom : 0;
+	long long distance = location < 0 ? -location : location;
+	if (ranges.size() == 0 || opensRange(ranges[ranges.size() - 1], rangeChrom, distance))
+	{
+		LocationRange range = { size(), distance - distance % LOCATION_WINDOW, rangeChrom, 0 };
+		ranges.push_back(range);
+	}
+	int32_t offset = (int32_t)(distance - ranges[ranges.size() - 1].base);
+	offsets.push_back(location < 0 ? ~offset : offset);
+	if (!chromosomeRuns)
+	{
+		chroms.push_back(chrom);
+	}
+}
+
+/*
+	function to append the targets of another column initialized the same way, the offsets and chromosomes are copied
+	as they are and the ranges are rebased after the current targets, a range continuing the last one is dropped
+
+	@param other	=> column appended
+ */
+void LocationColumn::append(const LocationColumn &other)
+{
+	unsigned long first = size();
+	for (unsigned long r = 0; r < other.ranges.size(); r++)
+	{
+		LocationRange range = other.ranges[r];
+		if (ranges.size() > 0 && ranges[ranges.size() - 1].chrom == range.chrom && ranges[ranges.size() - 1].base == range.base)
+		{
+			continue;
+		}
+		range.first += first;
+		ranges.push_back(range);
+	}
+	offsets.append(other.offsets);
+	if (!chromosomeRuns)
+	{
+		chroms.append(other.chroms);
+	}
+}
+
+/*
+	function to encode the location of a target, opening a range when the target starts a new chromosome or its
+	distance doesn't fit the window of the last range
+
+	@param index	=> store index of the target
+	@param chrom	=> chromosome of the target, 0 for a column keeping one chromosome per target
+	@param location	=> location of the target
+	@param ranges	=> ranges of the targets encoded before it, in store order, gets the new range if one is opened
+
+	@return offset	=> distance of the location from the base of its range, ones' complemented for a negative location
+ */
+int32_t LocationColumn::encode(unsigned long index, int chrom, long long location, vector<LocationRange> &ranges)
+{
+	long long distance = location < 0 ? -location : location;
+	if (ranges.empty() || opensRange(ranges.back(), chrom, distance))
+	{
+		LocationRange range = { index, distance - distance % LOCATION_WINDOW, chrom, 0 };
+		ranges.push_back(range);
+	}
+	int32_t offset = (int32_t)(distance - ranges.back().base);
+	return location < 0 ? ~offset : offset;
+}
+
+/*
+	function to append ranges encoded for targets after the current ones, a range continuing the last one is dropped
+
+	@param newRanges	=> ranges in store order
+ */
+void LocationColumn::appendRanges(const vector<LocationRange> &newRanges)
+{
+	for (unsigned long r = 0; r < newRanges.size(); r++)
+	{
+		if (ranges.size() > 0 && ranges[ranges.size() - 1].chrom == newRanges[r].chrom && ranges[ranges.size() - 1].base == newRanges[r].base)
+		{
+			continue;
+		}
+		ranges.push_back(newRanges[r]);
+	}
+}
+
+/*
+	function to view the columns of a reference index in memory owned elsewhere, dropping any owned values
+
+	@param offsetData	=> offset of each target
+	@param n			=> number of targets
+	@param rangeData	=> range table
+	@param rangeCount	=> number of ranges
+	@param chromData	=> chromosome of each target, null if the chromosomes are kept in the ranges
+ */
+void LocationColumn::attach(const int32_t *offsetData, unsigned long n, const LocationRange *rangeData, unsigned long rangeCount, const int *chromData)
+{
+	chromosomeRuns = chromData == nullptr;
+	offsets.attach(offsetData, n);
+	ranges.attach(rangeData, rangeCount);
+	chroms.attach(chromData, chromosomeRuns ? 0 : n);
+}
+
+/*
+	function to keep only the targets in [first, last), the ranges overlapping them are copied and rebased
+
+	@param first	=> index of the first target kept
+	@param last		=> index one past the last target kept
+ */
+void LocationColumn::slice(unsigned long first, unsigned long last)
+{
+	vector<LocationRange> kept;
+	for (unsigned long r = 0; r < ranges.size() && first < last; r++)
+	{
+		unsigned long rangeLast = r + 1 < ranges.size() ? ranges[r + 1].first : size();
+		if (rangeLast > first && ranges[r].first < last)
+		{
+			LocationRange range = ranges[r];
+			range.first = max((unsigned long)range.first, first) - first;
+			kept.push_back(range);
+		}
+	}
+	ranges.resize(kept.size());
+	for (unsigned long r = 0; r < kept.size(); r++)
+	{
+		ranges.set(r, kept[r]);
+	}
+	offsets.slice(first, last);
+	if (!chromosomeRuns)
+	{
+		chroms.slice(first, last);
+	}
+}
+
+/*
+	function to find the range holding the target at index
+
+	@param index	=> store index of the target
+
+	@return range	=> last range starting at or before index
+ */
+const LocationRange &LocationColumn::getRange(unsigned long index) const
+{
+	const LocationRange *begin = ranges.data(), *end = ranges.data() + ranges.size();
+	const LocationRange *next = upper_bound(begin, end, index, [](unsigned long i, const LocationRange &range) { return i < range.first; });
+	return *(next - 1);
+}
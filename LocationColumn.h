@@ -0,0 +1,97 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Column.h"
+
+using namespace std;
+
+/*
+	LocationRange describes consecutive targets whose locations are stored as 32-bit offsets from the same base
+	first	=> store index of the range's first target, the range ends where the next one starts
+	base	=> multiple of 2^31 added to the distance encoded in the offset of each target of the range
+	chrom	=> chromosome of every target of the range, 0 when the column stores one chromosome per target
+*/
+struct LocationRange
+{
+	uint64_t first;
+	int64_t base;
+	int32_t chrom;
+	int32_t reserved;
+};
+
+/*
+	LocationColumn holds the chromosome and location of every target of a reference store
+
+	Each target keeps a signed 32-bit offset, and a range table splits the store into runs of targets sharing a base.
+	The offset holds the distance of the location from the base, ones' complemented for a negative location (reverse
+	strand), so both strands of a window of 2^31 bases share a range. Locations of chromosomes shorter than 2^31 bases
+	fit with a base of 0, longer ones open a range per window they reach rather than one each time the strand changes.
+	Targets of a CSPR file come in contiguous runs per chromosome, so their chromosome is kept in the range table too
+	and costs nothing per target. The repeats DB interleaves chromosomes within a row, so a column initialized without
+	chromosome runs keeps one chromosome per target instead.
+
+	Like Column, the values are either owned while parsing or viewed in place in a mapped reference index.
+*/
+class LocationColumn
+{
+	public:
+		/* function to choose how chromosomes are stored and clear the column, runs in the range table by default */
+		void init(bool chromosomeRuns);
+
+		/* function to append the location of a target */
+		void push_back(int chrom, long long location);
+
+		/* function to append the targets of another column initialized the same way, its ranges are rebased */
+		void append(const LocationColumn &other);
+
+		/* function to resize the offsets, the ranges of new targets are added with appendRanges */
+		void resize(unsigned long n) { offsets.resize(n); }
+
+		/* function to overwrite the offset of a target, safe from several threads for distinct indexes */
+		void setOffset(unsigned long index, int32_t offset) { offsets.set(index, offset); }
+
+		/* function to append ranges encoded for targets after the current ones */
+		void appendRanges(const vector<LocationRange> &newRanges);
+
+		/* function to encode the location of the target at index, opening a range in ranges when it needs one */
+		static int32_t encode(unsigned long index, int chrom, long long location, vector<LocationRange> &ranges);
+
+		/* function to view the columns of an index in memory owned elsewhere, chroms is null with chromosome runs */
+		void attach(const int32_t *offsetData, unsigned long n, const LocationRange *rangeData, unsigned long rangeCount, const int *chromData);
+
+		/* function to keep only the targets in [first, last) */
+		void slice(unsigned long first, unsigned long last);
+
+		/* returns the location of the target at index */
+		long long getLocation(unsigned long index) const
+		{
+			int32_t offset = offsets[index];
+			return offset >= 0 ? getRange(index).base + offset : -(getRange(index).base + ~offset);
+		}
+
+		/* returns the chromosome of the target at index */
+		int getChrom(unsigned long index) const { return chromosomeRuns ? getRange(index).chrom : chroms[index]; }
+
+		/* returns the number of targets */
+		unsigned long size() const { return offsets.size(); }
+
+		/* returns the stored columns, written as sections of a reference index */
+		const Column<int32_t> &getOffsets() const { return offsets; }
+		const Column<LocationRange> &getRanges() const { return ranges; }
+		const Column<int> &getChroms() const { return chroms; }
+
+	private:
+		/*
+			chromosomeRuns	=> true if the chromosome of each target is kept in its range
+			offsets			=> offset of each target from the base of its range
+			ranges			=> ranges in store order, the first one starts at index 0
+			chroms			=> chromosome of each target, empty with chromosome runs
+		*/
+		bool chromosomeRuns = true;
+		Column<int32_t> offsets;
+		Column<LocationRange> ranges;
+		Column<int> chroms;
+
+		/* function to find the range holding the target at index */
+		const LocationRange &getRange(unsigned long index) const;
+};
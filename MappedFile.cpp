@@ -0,0 +1,69 @@
+#include "MappedFile.h"
+#include <fstream>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/*
+	unmaps the file
+ */
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+	if (mapped)
+	{
+		munmap((void *)mapping, mappingSize);
+	}
+#endif
+}
+
+/*
+	function to map a file read-only
+
+	@param filePath	=> file path of the file to map
+
+	@return true	=> the file's bytes are available through data()
+	@return false	=> the file couldn't be opened, mapped or read
+ */
+bool MappedFile::open(const string &filePath)
+{
+	struct stat fileStat;
+	if (stat(filePath.c_str(), &fileStat) != 0)
+	{
+		return false;
+	}
+	mappingSize = fileStat.st_size;
+	if (mappingSize == 0)
+	{
+		mapping = (const char *)buffer.data();
+		return true;
+	}
+
+#ifndef _WIN32
+	int fd = ::open(filePath.c_str(), O_RDONLY);
+	if (fd >= 0)
+	{
+		void *address = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (address != MAP_FAILED)
+		{
+			mapping = (const char *)address;
+			mapped = true;
+			return true;
+		}
+	}
+#endif
+
+	/* no mmap, read the file into the buffer instead */
+	ifstream file(filePath, ios::binary);
+	buffer.resize((mappingSize + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+	if (!file.read((char *)buffer.data(), mappingSize))
+	{
+		return false;
+	}
+	mapping = (const char *)buffer.data();
+	return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/*
+	MappedFile maps a whole file read-only into memory
+
+	Where mmap isn't available the file is read into a buffer instead, so callers see the same contiguous bytes either
+	way. The buffer is 8 byte aligned and a mapping is page aligned.
+*/
+class MappedFile
+{
+	public:
+		MappedFile() {}
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator=(const MappedFile &) = delete;
+
+		/* unmaps the file */
+		~MappedFile();
+
+		/* function to map a file, returns false if it can't be opened or mapped */
+		bool open(const string &filePath);
+
+		/* returns the first byte of the file */
+		const char *data() const { return mapping; }
+
+		/* returns the size of the file in bytes */
+		uint64_t size() const { return mappingSize; }
+
+	private:
+		const char *mapping = nullptr;
+		uint64_t mappingSize = 0;
+		bool mapped = false;
+		vector<uint64_t> buffer;
+};
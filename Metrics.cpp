@@ -0,0 +1,109 @@
+#include "Metrics.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+/* names of the phases and counters in the report, in enum order */
+static const char *PHASE_NAMES[Metrics::PHASE_COUNT] = { "parse_casperinfo", "parse_cspr", "parse_repeats", "map_reference", "publish_reference", "build_seed_index", "build_fm_index", "build_qgram_filter", "parse_queries", "unique_scan", "repeat_scan", "format_output", "write_output" };
+static const char *COUNTER_NAMES[Metrics::COUNTER_COUNT] = { "targets_examined", "targets_skipped", "targets_filtered", "candidates", "hits_scored", "hits_pruned", "hits_reported", "queries", "bytes_written" };
+
+/*
+	starts the report clock with every phase and counter at 0
+ */
+Metrics::Metrics() : start(now())
+{
+	for (int p = 0; p < PHASE_COUNT; p++)
+	{
+		phaseNanoseconds[p] = 0;
+	}
+	for (int c = 0; c < COUNTER_COUNT; c++)
+	{
+		counters[c] = 0;
+	}
+}
+
+/*
+	function to add the busy time of each worker of a thread pool and the time the pool was running, the rest of which
+	the worker spent idle
+
+	@param busyNanoseconds	=> time each worker spent running tasks, by worker index
+	@param runNanoseconds	=> time between starting and stopping the pool
+ */
+void Metrics::addThreadTimes(const vector<uint64_t> &busyNanoseconds, uint64_t runNanoseconds)
+{
+	lock_guard<mutex> lock(threadLock);
+	if (threadBusy.size() < busyNanoseconds.size())
+	{
+		threadBusy.resize(busyNanoseconds.size(), 0);
+		threadIdle.resize(busyNanoseconds.size(), 0);
+	}
+	for (unsigned long t = 0; t < busyNanoseconds.size(); t++)
+	{
+		threadBusy[t] += busyNanoseconds[t];
+		threadIdle[t] += runNanoseconds > busyNanoseconds[t] ? runNanoseconds - busyNanoseconds[t] : 0;
+	}
+}
+
+/*
+	function to format the report as JSON: elapsed time, seconds per phase, counters, the share of the examined targets
+	the mismatch filter rejected, the share of the targets reaching the q-gram filter it rejected and the busy and idle
+	seconds of each worker thread
+
+	@return json	=> the report
+ */
+string Metrics::toJson() const
+{
+	ostringstream json;
+	uint64_t examined = counters[TARGETS_EXAMINED], candidates = counters[CANDIDATES], filtered = counters[TARGETS_FILTERED];
+
+	json << setprecision(9);
+	json << "{\n";
+	json << "  \"elapsed_seconds\": " << (now() - start) / 1e9 << ",\n";
+	json << "  \"phases\": {";
+	for (int p = 0; p < PHASE_COUNT; p++)
+	{
+		json << (p > 0 ? ", " : "") << "\"" << PHASE_NAMES[p] << "\": " << phaseNanoseconds[p] / 1e9;
+	}
+	json << "},\n";
+	json << "  \"counters\": {";
+	for (int c = 0; c < COUNTER_COUNT; c++)
+	{
+		json << (c > 0 ? ", " : "") << "\"" << COUNTER_NAMES[c] << "\": " << counters[c];
+	}
+	json << "},\n";
+	json << "  \"mismatch_filter_rejection_rate\": " << (examined > 0 ? double(examined - min(examined, candidates)) / examined : 0.0) << ",\n";
+	json << "  \"qgram_filter_rejection_rate\": " << (filtered > 0 ? double(filtered) / (filtered + examined) : 0.0) << ",\n";
+
+	lock_guard<mutex> lock(threadLock);
+	json << "  \"threads\": [";
+	for (unsigned long t = 0; t < threadBusy.size(); t++)
+	{
+		json << (t > 0 ? ", " : "") << "{\"busy_seconds\": " << threadBusy[t] / 1e9 << ", \"idle_seconds\": " << threadIdle[t] / 1e9 << "}";
+	}
+	json << "]\n";
+	json << "}\n";
+	return json.str();
+}
+
+/*
+	function to write the JSON report to a file
+
+	@param filePath	=> file the report is written to, replaced if it exists
+
+	@return true	=> the report was written
+	@return false	=> the file couldn't be written, a message is printed
+ */
+bool Metrics::write(const string &filePath) const
+{
+	ofstream file(filePath);
+	file << toJson();
+	file.close();
+	if (file.fail())
+	{
+		cerr << "Metrics report " << filePath << " couldn't be written." << endl;
+		return false;
+	}
+	return true;
+}
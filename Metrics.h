@@ -0,0 +1,88 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+using namespace std;
+
+/*
+	Metrics collects the time spent in each phase of an OT run and counters of the work done by the scans
+
+	Phases run by one thread at a time are wall time, the scan and output formatting phases run on the worker threads
+	and are summed over them. Timers and counters are plain relaxed atomics updated once per task or per query, and the
+	scans count into their hit buffers, so collecting costs nothing measurable and is always on; --metrics only decides
+	whether the report is written.
+*/
+class Metrics
+{
+	public:
+		enum Phase
+		{
+			PARSE_CASPERINFO,
+			PARSE_CSPR,
+			PARSE_REPEATS,
+			MAP_REFERENCE,
+			PUBLISH_REFERENCE,
+			BUILD_SEED_INDEX,
+			BUILD_FM_INDEX,
+			BUILD_QGRAM_FILTER,
+			PARSE_QUERIES,
+			UNIQUE_SCAN,
+			REPEAT_SCAN,
+			FORMAT_OUTPUT,
+			WRITE_OUTPUT,
+			PHASE_COUNT
+		};
+
+		enum Counter
+		{
+			TARGETS_EXAMINED,
+			TARGETS_SKIPPED,
+			TARGETS_FILTERED,
+			CANDIDATES,
+			HITS_SCORED,
+			HITS_PRUNED,
+			HITS_REPORTED,
+			QUERIES,
+			BYTES_WRITTEN,
+			COUNTER_COUNT
+		};
+
+		Metrics();
+		Metrics(const Metrics &) = delete;
+		Metrics &operator=(const Metrics &) = delete;
+
+		/* returns a monotonic timestamp in nanoseconds */
+		static uint64_t now() { return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count(); }
+
+		/* function to add the time since start, taken with now(), to a phase */
+		void addTime(Phase phase, uint64_t start) { phaseNanoseconds[phase].fetch_add(now() - start, memory_order_relaxed); }
+
+		/* function to add to a counter */
+		void add(Counter counter, uint64_t value) { counters[counter].fetch_add(value, memory_order_relaxed); }
+
+		/* function to add the busy time of each worker of a thread pool and the time the pool was running */
+		void addThreadTimes(const vector<uint64_t> &busyNanoseconds, uint64_t runNanoseconds);
+
+		/* function to format the report as JSON */
+		string toJson() const;
+
+		/* function to write the JSON report to a file, returns false if it couldn't be written */
+		bool write(const string &filePath) const;
+
+	private:
+		/*
+			start				=> timestamp of the creation of the object, the report covers the time since
+			phaseNanoseconds	=> time spent in each phase
+			counters			=> value of each counter
+			threadBusy/Idle		=> time each worker thread spent running and waiting for tasks, by worker index
+		*/
+		uint64_t start;
+		atomic<uint64_t> phaseNanoseconds[PHASE_COUNT];
+		atomic<uint64_t> counters[COUNTER_COUNT];
+		mutable mutex threadLock;
+		vector<uint64_t> threadBusy, threadIdle;
+};
@@ -0,0 +1,187 @@
+#include "MismatchKernel.h"
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OT_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/*
+	portable kernel, also used for the tail of the vectorized kernels and for sequence lengths they do not cover
+
+	@param refWords		=> packed words of targetCount consecutive reference targets
+	@param queryWords	=> packed words of the query sequence
+	@param wordsPerSeq	=> number of packed words per sequence
+	@param targetCount	=> number of targets to compare
+	@param counts		=> filled with the mismatch count of each target
+	@param masks		=> filled with the folded mismatch masks of each target
+ */
+static void compareScalar(const uint64_t *refWords, const uint64_t *queryWords, int wordsPerSeq, int targetCount, uint8_t *counts, uint64_t *masks)
+{
+	for (int t = 0; t < targetCount; t++)
+	{
+		int count = 0;
+		for (int w = 0; w < wordsPerSeq; w++)
+		{
+			uint64_t mask = mismatchMask(refWords[t * wordsPerSeq + w], queryWords[w]);
+			masks[t * wordsPerSeq + w] = mask;
+			count += popCount64(mask);
+		}
+		counts[t] = (uint8_t)count;
+	}
+}
+
+/*
+	sum the per word popcounts of each target and finish any words the vector loop did not cover
+
+	@param firstWord	=> first word index not handled by the vector loop
+	@param wordCounts	=> popcount of each word handled by the vector loop
+ */
+static void finishCounts(const uint64_t *refWords, const uint64_t *queryWords, int wordsPerSeq, int targetCount, uint8_t *counts, uint64_t *masks, int firstWord, uint8_t *wordCounts)
+{
+	for (int w = firstWord; w < targetCount * wordsPerSeq; w++)
+	{
+		masks[w] = mismatchMask(refWords[w], queryWords[w % wordsPerSeq]);
+		wordCounts[w] = (uint8_t)popCount64(masks[w]);
+	}
+	for (int t = 0; t < targetCount; t++)
+	{
+		int count = 0;
+		for (int w = 0; w < wordsPerSeq; w++)
+		{
+			count += wordCounts[t * wordsPerSeq + w];
+		}
+		counts[t] = (uint8_t)count;
+	}
+}
+
+#ifdef OT_X86_KERNELS
+/* AVX2 kernel: four words per instruction, popcount through a nibble lookup table */
+__attribute__((target("avx2")))
+static void compareAvx2(const uint64_t *refWords, const uint64_t *queryWords, int wordsPerSeq, int targetCount, uint8_t *counts, uint64_t *masks)
+{
+	if (4 % wordsPerSeq != 0)
+	{
+		compareScalar(refWords, queryWords, wordsPerSeq, targetCount, counts, masks);
+		return;
+	}
+
+	uint8_t wordCounts[KERNEL_BLOCK_SIZE * KERNEL_MAX_WORDS];
+	uint64_t laneCounts[4];
+	const __m256i query = _mm256_setr_epi64x(queryWords[0], queryWords[1 % wordsPerSeq], queryWords[2 % wordsPerSeq], queryWords[3 % wordsPerSeq]);
+	const __m256i lowBits = _mm256_set1_epi64x(0x5555555555555555LL);
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const int words = targetCount * wordsPerSeq;
+
+	int w = 0;
+	for (; w + 4 <= words; w += 4)
+	{
+		__m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(refWords + w)), query);
+		__m256i mask = _mm256_and_si256(_mm256_or_si256(x, _mm256_srli_epi64(x, 1)), lowBits);
+		_mm256_storeu_si256((__m256i *)(masks + w), mask);
+
+		__m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(mask, nibble)), _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(mask, 4), nibble)));
+		_mm256_storeu_si256((__m256i *)laneCounts, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+		for (int lane = 0; lane < 4; lane++)
+		{
+			wordCounts[w + lane] = (uint8_t)laneCounts[lane];
+		}
+	}
+
+	finishCounts(refWords, queryWords, wordsPerSeq, targetCount, counts, masks, w, wordCounts);
+}
+
+/* AVX-512 kernel: eight words per instruction with the native 64-bit popcount */
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static void compareAvx512(const uint64_t *refWords, const uint64_t *queryWords, int wordsPerSeq, int targetCount, uint8_t *counts, uint64_t *masks)
+{
+	if (4 % wordsPerSeq != 0)
+	{
+		compareScalar(refWords, queryWords, wordsPerSeq, targetCount, counts, masks);
+		return;
+	}
+
+	uint8_t wordCounts[KERNEL_BLOCK_SIZE * KERNEL_MAX_WORDS];
+	const __m512i query = _mm512_setr_epi64(queryWords[0], queryWords[1 % wordsPerSeq], queryWords[2 % wordsPerSeq], queryWords[3 % wordsPerSeq],
+		queryWords[4 % wordsPerSeq], queryWords[5 % wordsPerSeq], queryWords[6 % wordsPerSeq], queryWords[7 % wordsPerSeq]);
+	const __m512i lowBits = _mm512_set1_epi64(0x5555555555555555LL);
+	const int words = targetCount * wordsPerSeq;
+
+	int w = 0;
+	for (; w + 8 <= words; w += 8)
+	{
+		__m512i x = _mm512_xor_si512(_mm512_loadu_si512((const void *)(refWords + w)), query);
+		__m512i mask = _mm512_and_si512(_mm512_or_si512(x, _mm512_srli_epi64(x, 1)), lowBits);
+		_mm512_storeu_si512((void *)(masks + w), mask);
+		_mm_storel_epi64((__m128i *)(wordCounts + w), _mm512_cvtepi64_epi8(_mm512_popcnt_epi64(mask)));
+	}
+
+	finishCounts(refWords, queryWords, wordsPerSeq, targetCount, counts, masks, w, wordCounts);
+}
+#endif
+
+/*
+	selects the fastest kernel implementation supported by the running CPU
+ */
+MismatchKernel::MismatchKernel()
+{
+	select("auto");
+}
+
+/*
+	function to select a kernel implementation by name
+
+	@param kernelName	=> auto for the fastest one, or scalar, avx2 or avx512
+
+	@return true	=> the implementation is selected
+	@return false	=> unknown name or not supported by the running CPU, the selection is unchanged
+ */
+bool MismatchKernel::select(const string &kernelName)
+{
+	vector<string> supported = getSupportedNames();
+	string selected = kernelName == "auto" ? supported.back() : kernelName;
+
+	if (find(supported.begin(), supported.end(), selected) == supported.end())
+	{
+		return false;
+	}
+	compareFunction = compareScalar;
+	name = "scalar";
+#ifdef OT_X86_KERNELS
+	if (selected == "avx512")
+	{
+		compareFunction = compareAvx512;
+		name = "AVX-512";
+	}
+	else if (selected == "avx2")
+	{
+		compareFunction = compareAvx2;
+		name = "AVX2";
+	}
+#endif
+	return true;
+}
+
+/*
+	function to list the kernel implementations supported by the running CPU
+
+	@return names	=> names accepted by select, scalar first and the fastest last
+ */
+vector<string> MismatchKernel::getSupportedNames()
+{
+	vector<string> names = {"scalar"};
+
+#ifdef OT_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		names.push_back("avx2");
+	}
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+	{
+		names.push_back("avx512");
+	}
+#endif
+	return names;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "PackedSequences.h"
+#include <string>
+#include <vector>
+
+/* number of reference targets compared per kernel call */
+const int KERNEL_BLOCK_SIZE = 32;
+
+/* largest number of packed words per sequence the kernels handle (128 bases) */
+const int KERNEL_MAX_WORDS = 4;
+
+/*
+	MismatchKernel compares a block of packed reference targets against one packed query
+
+	The implementation is picked once at construction from the features of the running CPU (AVX-512 VPOPCNTDQ, AVX2 or
+	portable scalar code). Every implementation fills in identical counts and masks, so results never depend on the
+	machine the algorithm runs on. Another implementation the CPU supports can be selected by name, which lets the
+	kernels be checked against each other on one machine.
+*/
+class MismatchKernel
+{
+	public:
+		/* signature shared by all kernel implementations */
+		typedef void (*CompareFunction)(const uint64_t *refWords, const uint64_t *queryWords, int wordsPerSeq, int targetCount, uint8_t *counts, uint64_t *masks);
+
+		/* selects the fastest implementation supported by the running CPU */
+		MismatchKernel();
+
+		/* function to select an implementation by name (auto, scalar, avx2 or avx512), returns false if it isn't supported */
+		bool select(const string &kernelName);
+
+		/* returns the names of the implementations supported by the running CPU, scalar first */
+		static vector<string> getSupportedNames();
+
+		/*
+			compare targetCount consecutive packed targets against the query
+
+			counts receives the number of mismatches of each target and masks receives wordsPerSeq folded
+			mismatch masks per target (see mismatchMask), targetCount must not exceed KERNEL_BLOCK_SIZE
+		*/
+		void compare(const uint64_t *refWords, const uint64_t *queryWords, int wordsPerSeq, int targetCount, uint8_t *counts, uint64_t *masks) const
+		{
+			compareFunction(refWords, queryWords, wordsPerSeq, targetCount, counts, masks);
+		}
+
+		/* returns the name of the selected implementation */
+		const char *getName() const { return name; }
+
+	private:
+		CompareFunction compareFunction;
+		const char *name;
+};
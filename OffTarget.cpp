@@ -24,272 +24,1484 @@ void OffTarget::parseInputArguments(int argc, char *argv[])
 		avgOutput = true;
 	}
 	hsuMatrixName = string(argv[11]);
+
+	/* parse optional arguments given as --name=value */
+	for (int i = 12; i < argc; i++)
+	{
+		if (!parseOptionalArgument(string(argv[i])))
+		{
+			cerr << "Invalid optional argument: " << argv[i] << endl;
+			exit(-1);
+		}
+	}
+}
+
+/*
+	function for parsing one optional argument given as --name=value
+
+	@param arg	=> argument to parse
+
+	@return true	=> the argument was recognized and stored
+	@return false	=> unknown argument or invalid value
+*/
+bool OffTarget::parseOptionalArgument(const string &arg)
+{
+	size_t split = arg.find('=');
+	string name = arg.substr(0, split);
+	string value = split == string::npos ? "" : arg.substr(split + 1);
+
+	if (name == "--engine" && (value == "auto" || value == "scan" || value == "seed" || value == "fm"))
+	{
+		engine = value;
+	}
+	else if (name == "--threads" && atoi(value.c_str()) > 0)
+	{
+		threadCount = atoi(value.c_str());
+	}
+	else if (name == "--kernel")
+	{
+		return kernel.select(value);
+	}
+	else if (name == "--top-k" && atol(value.c_str()) > 0)
+	{
+		topK = (unsigned long)atol(value.c_str());
+	}
+	else if (name == "--index" && value != "")
+	{
+		indexFilePath = value;
+	}
+	else if (name == "--tile-targets" && atol(value.c_str()) > 0)
+	{
+		tileTargets = (unsigned long)atol(value.c_str());
+	}
+	else if (name == "--tile-queries" && atol(value.c_str()) > 0)
+	{
+		tileQueries = (unsigned long)atol(value.c_str());
+	}
+	else if (arg == "--shared-memory")
+	{
+		useSharedMemory = true;
+	}
+	else if (arg == "--qgram-filter")
+	{
+		useQGramFilter = true;
+	}
+	else if (name == "--shards" && atoi(value.c_str()) > 0)
+	{
+		shardCount = atoi(value.c_str());
+	}
+	else if (name == "--metrics" && value != "")
+	{
+		metricsFilePath = value;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+/*
+	function for parsing the organism arguments of server mode: endo;csprFile;sqlFile;casperInfoFile;maxMismatches;
+	hsuMatrixName followed by any optional arguments
+
+	@param fields	=> arguments split from a line of the organisms file, without the organism name
+
+	@return true	=> every argument was valid
+	@return false	=> missing arguments or an invalid optional argument
+*/
+bool OffTarget::parseOrganismArguments(vector<string> &fields)
+{
+	if (fields.size() < 6 || atoi(fields[4].c_str()) < 0)
+	{
+		return false;
+	}
+	endo = fields[0];
+	csprFilePath = fields[1];
+	sqlFilePath = fields[2];
+	casperInfoFilePath = fields[3];
+	maxMismatches = atoi(fields[4].c_str());
+	hsuMatrixName = fields[5];
+	for (unsigned long i = 6; i < fields.size(); i++)
+	{
+		if (!parseOptionalArgument(fields[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+	function for parsing the input arguments of index mode: OT index endo csprFile sqlFile casperInfoFile indexFile
+	followed by any optional arguments, --engine=fm also writes the FM indexes
+
+	@param argc	=> number of input arguments
+	@param argv	=> array of input arguments
+*/
+void OffTarget::parseIndexArguments(int argc, char *argv[])
+{
+	if (argc < 7)
+	{
+		cerr << "Usage: OT index endonuclease cspr_file_path db_file_path CASPERinfo_file_path index_file_path [--engine=fm] [--threads=N]" << endl;
+		exit(-1);
+	}
+	endo = string(argv[2]);
+	csprFilePath = string(argv[3]);
+	sqlFilePath = string(argv[4]);
+	casperInfoFilePath = string(argv[5]);
+	indexFilePath = string(argv[6]);
+	for (int i = 7; i < argc; i++)
+	{
+		if (!parseOptionalArgument(string(argv[i])))
+		{
+			cerr << "Invalid optional argument: " << argv[i] << endl;
+			exit(-1);
+		}
+	}
+}
+
+/*
+	function for parsing a CSPR file and its repeats DB and writing them to a reference index
+*/
+void OffTarget::buildIndex()
+{
+	FileOp.parseEndoData(casperInfoFilePath, endo, endoData);
+	if (endoData[4] > 32 * KERNEL_MAX_WORDS)
+	{
+		cerr << "Sequence length is longer than the supported " << 32 * KERNEL_MAX_WORDS << " bases." << endl;
+		exit(-1);
+	}
+	uniqueSeqs.init(endoData[4]);
+	repeatSeqs.init(endoData[4]);
+	FileOp.parseCsprFile(csprFilePath, uniqueSeqs, uniqueScores, uniqueLocations, threadCount, 0, 1);
+	FileOp.parseSqlFile(sqlFilePath, repeatSeqs, repeatScores, repeatLocations, repeatGroups, threadCount, 0, 1, nullptr);
+	if (engine == "fm")
+	{
+		buildFmIndexes();
+	}
+	ReferenceIndex::write(indexFilePath, endoData[4], ReferenceIndex::fingerprint(csprFilePath), ReferenceIndex::fingerprint(sqlFilePath), uniqueSeqs, uniqueScores, uniqueLocations, repeatSeqs, repeatScores, repeatLocations, repeatGroups, uniqueFmIndex, repeatFmIndex);
+}
+
+/*
+	function to load the reference stores from the index given by --index
+
+	@return true	=> the stores view the mapped index
+	@return false	=> the index couldn't be used and the source files have to be parsed, a message is printed
+*/
+bool OffTarget::loadIndex()
+{
+	if (!referenceIndex.open(indexFilePath))
+	{
+		return false;
+	}
+	const ReferenceIndex::Header &header = referenceIndex.getHeader();
+	if ((int)header.seqLength != endoData[4])
+	{
+		cerr << "Index file " << indexFilePath << " was built for another endonuclease." << endl;
+		return false;
+	}
+	if (header.csprFingerprint != ReferenceIndex::fingerprint(csprFilePath) || header.dbFingerprint != ReferenceIndex::fingerprint(sqlFilePath))
+	{
+		cerr << "Index file " << indexFilePath << " does not match the CSPR and DB files." << endl;
+		return false;
+	}
+	referenceIndex.attach(uniqueSeqs, uniqueScores, uniqueLocations, repeatSeqs, repeatScores, repeatLocations, repeatGroups);
+	return true;
+}
+
+/*
+	function to point the reference stores at the shared memory copy published by another OT process
+
+	@return true	=> the stores view the shared segment
+	@return false	=> the reference has to be loaded, if the segment is open this process publishes it afterwards
+*/
+bool OffTarget::attachSharedReference()
+{
+	if (!sharedReference.open(endoData[4], ReferenceIndex::fingerprint(csprFilePath), ReferenceIndex::fingerprint(sqlFilePath)) || !sharedReference.isPublished())
+	{
+		return false;
+	}
+	if (!sharedIndex.open(sharedReference.data(), sharedReference.size(), "Shared memory segment " + sharedReference.getName()))
+	{
+		return false;
+	}
+	sharedIndex.attach(uniqueSeqs, uniqueScores, uniqueLocations, repeatSeqs, repeatScores, repeatLocations, repeatGroups);
+	return true;
+}
+
+/*
+	function to copy the loaded reference stores into the shared memory segment opened by attachSharedReference and
+	point the stores at it, freeing this process's own copy
+*/
+void OffTarget::publishSharedReference()
+{
+	/* the segment couldn't be opened or another process's copy is used */
+	if (!sharedReference.isOpen() || sharedReference.isPublished())
+	{
+		return;
+	}
+
+	uint64_t csprFingerprint = ReferenceIndex::fingerprint(csprFilePath), dbFingerprint = ReferenceIndex::fingerprint(sqlFilePath);
+	uint64_t size = ReferenceIndex::writeImage(nullptr, endoData[4], csprFingerprint, dbFingerprint, uniqueSeqs, uniqueScores, uniqueLocations, repeatSeqs, repeatScores, repeatLocations, repeatGroups, uniqueFmIndex, repeatFmIndex);
+	char *image = sharedReference.create(size);
+	if (image == nullptr)
+	{
+		return;
+	}
+	ReferenceIndex::writeImage(image, endoData[4], csprFingerprint, dbFingerprint, uniqueSeqs, uniqueScores, uniqueLocations, repeatSeqs, repeatScores, repeatLocations, repeatGroups, uniqueFmIndex, repeatFmIndex);
+	sharedReference.publish();
+	if (sharedIndex.open(sharedReference.data(), sharedReference.size(), "Shared memory segment " + sharedReference.getName()))
+	{
+		sharedIndex.attach(uniqueSeqs, uniqueScores, uniqueLocations, repeatSeqs, repeatScores, repeatLocations, repeatGroups);
+		sharedIndex.attachFmIndexes(uniqueFmIndex, repeatFmIndex, maxMismatches);
+	}
+}
+
+/*
+	function for calling file operations object to parse data needed for algorithm:
+*/
+void OffTarget::getAlgorithmData()
+{
+	loadReference();
+	uint64_t start = Metrics::now();
+	FileOp.parseQueryFile(queryFilePath, querySeqs, queryScores);
+	metrics.addTime(Metrics::PARSE_QUERIES, start);
+}
+
+/*
+	function for loading CASPERinfo and the reference targets and preparing the scoring tables and indexes
+*/
+void OffTarget::loadReference()
+{
+	uint64_t start = Metrics::now();
+	FileOp.parseCasperInfo(casperInfoFilePath, endo, endoData, hsuMatrixName, hsuMatrix);
+	metrics.addTime(Metrics::PARSE_CASPERINFO, start);
+	if (endoData[4] > 32 * KERNEL_MAX_WORDS)
+	{
+		cerr << "Sequence length is longer than the supported " << 32 * KERNEL_MAX_WORDS << " bases." << endl;
+		exit(-1);
+	}
+
+	/* parse the reference files unless a shared copy or an up to date index of them can be mapped */
+	start = Metrics::now();
+	bool shared = useSharedMemory && attachSharedReference();
+	bool mapped = shared || (indexFilePath != "" && loadIndex());
+
+	/* the fm engine views the FM indexes of the mapped reference when they were written with it */
+	if (mapped && engine == "fm")
+	{
+		(shared ? sharedIndex : referenceIndex).attachFmIndexes(uniqueFmIndex, repeatFmIndex, maxMismatches);
+	}
+	metrics.addTime(Metrics::MAP_REFERENCE, start);
+
+	/* a shard worker parses only its shard, unless it publishes the whole reference for the other processes */
+	bool parseShard = !mapped && shardIndex >= 0 && !sharedReference.isOpen();
+	if (!mapped)
+	{
+		if (indexFilePath != "")
+		{
+			cerr << "Parsing the CSPR and DB files instead." << endl;
+		}
+		uniqueSeqs.init(endoData[4]);
+		repeatSeqs.init(endoData[4]);
+		start = Metrics::now();
+		FileOp.parseCsprFile(csprFilePath, uniqueSeqs, uniqueScores, uniqueLocations, threadCount, parseShard ? shardIndex : 0, parseShard ? shardCount : 1);
+		metrics.addTime(Metrics::PARSE_CSPR, start);
+		start = Metrics::now();
+		FileOp.parseSqlFile(sqlFilePath, repeatSeqs, repeatScores, repeatLocations, repeatGroups, threadCount, parseShard ? shardIndex : 0, parseShard ? shardCount : 1, repeatRowidRanges.groupEnds.empty() ? nullptr : &repeatRowidRanges);
+		metrics.addTime(Metrics::PARSE_REPEATS, start);
+	}
+	if (useSharedMemory && !shared)
+	{
+		/* the FM indexes are published with the stores so the processes mapping them don't build their own */
+		if (engine == "fm" && sharedReference.isOpen())
+		{
+			buildFmIndexes();
+		}
+		start = Metrics::now();
+		publishSharedReference();
+		metrics.addTime(Metrics::PUBLISH_REFERENCE, start);
+	}
+	if (shardIndex >= 0 && !parseShard)
+	{
+		keepShard();
+	}
+
+	//store three prime
+	if (endoData[5] == 3)
+	{
+		three_prime = true;
+	}
+	else
+	{
+		three_prime = false;
+	}
+
+	/* precompute the per position scoring tables and pick the kernel for this endo's geometry */
+	score.init(hsuMatrix, endoData[4]);
+	scoreBlock = selectScoreBlock();
+
+	/* the seed index pays off when few targets share a segment with a query, which depends on the segment length */
+	if (engine == "seed" || (engine == "auto" && SeedIndex::candidateFraction(endoData[4], maxMismatches) <= 1.0 / 64))
+	{
+		start = Metrics::now();
+		uniqueIndex.build(uniqueSeqs, endoData[4], maxMismatches);
+		repeatIndex.build(repeatSeqs, endoData[4], maxMismatches);
+		useSeedIndex = uniqueIndex.isBuilt() && repeatIndex.isBuilt();
+		metrics.addTime(Metrics::BUILD_SEED_INDEX, start);
+	}
+	else if (engine == "fm")
+	{
+		/* built here only when neither the index nor the shared segment holds them */
+		if (!uniqueFmIndex.isBuilt() || !repeatFmIndex.isBuilt())
+		{
+			buildFmIndexes();
+		}
+		useFmIndex = uniqueFmIndex.isBuilt() && repeatFmIndex.isBuilt();
+	}
+
+	/* the index engines only compare their candidates, the q-gram filter is for scans */
+	if (useQGramFilter && !useSeedIndex && !useFmIndex)
+	{
+		start = Metrics::now();
+		uniqueFilter.build(uniqueSeqs, endoData[4], maxMismatches);
+		repeatFilter.build(repeatSeqs, endoData[4], maxMismatches);
+		metrics.addTime(Metrics::BUILD_QGRAM_FILTER, start);
+	}
+}
+
+/*
+	function to keep only this worker's shard of mapped or fully loaded reference stores, a worker parsing the source
+	files reads only its shard instead
+
+	Unique targets are split into equal index ranges and repeat targets into equal ranges of seed groups, so every shard
+	can still skip whole groups, by getShardWindow as the parsers split them. The groups are rebased onto the shard.
+	Shards are in reference order, so merging the hits of each query in shard order gives the hits of a single process
+	run.
+*/
+void OffTarget::keepShard()
+{
+	/* vars */
+	unsigned long uniqueFirst, uniqueLast, groupFirst, groupLast;
+	unsigned long groupCount = repeatGroups.size();
+	getShardWindow(uniqueSeqs.size(), shardIndex, shardCount, uniqueFirst, uniqueLast);
+	getShardWindow(groupCount, shardIndex, shardCount, groupFirst, groupLast);
+	unsigned long repeatFirst = groupFirst < groupCount ? repeatGroups[groupFirst].first : repeatSeqs.size();
+	unsigned long repeatLast = groupLast < groupCount ? repeatGroups[groupLast].first : repeatSeqs.size();
+
+	uniqueSeqs.slice(uniqueFirst, uniqueLast);
+	uniqueScores.slice(uniqueFirst, uniqueLast);
+	uniqueLocations.slice(uniqueFirst, uniqueLast);
+
+	vector<RepeatGroup> groups(repeatGroups.data() + groupFirst, repeatGroups.data() + groupLast);
+	repeatGroups.resize(groups.size());
+	for (unsigned long g = 0; g < groups.size(); g++)
+	{
+		groups[g].first -= repeatFirst;
+		repeatGroups.set(g, groups[g]);
+	}
+	repeatSeqs.slice(repeatFirst, repeatLast);
+	repeatScores.slice(repeatFirst, repeatLast);
+	repeatLocations.slice(repeatFirst, repeatLast);
+
+	/* FM indexes mapped with the whole reference only return the candidates of the shard */
+	if (uniqueFmIndex.isBuilt() && repeatFmIndex.isBuilt())
+	{
+		uniqueFmIndex.setWindow(uniqueFirst, uniqueLast);
+		repeatFmIndex.setWindow(repeatFirst, repeatLast);
+	}
+}
+
+/*
+	function to build the FM indexes over the reference stores, for the fm engine or a reference index written for it
+*/
+void OffTarget::buildFmIndexes()
+{
+	uint64_t start = Metrics::now();
+	uniqueFmIndex.build(uniqueSeqs, endoData[4], maxMismatches);
+	repeatFmIndex.build(repeatSeqs, endoData[4], maxMismatches);
+	metrics.addTime(Metrics::BUILD_FM_INDEX, start);
+}
+
+/* 
+	function for running the OffTarget algorithm
+ */
+void OffTarget::run()
+{
+	/* vars */
+	QueryBatch queryBatch;
+	queryBatch.querySeqs = querySeqs;
+	queryBatch.queryScores = queryScores;
+	queryBatch.threshold = threshold;
+	queryBatch.topK = topK;
+	queryBatch.avgOutput = avgOutput;
+
+	/* open output file object, blocks are streamed to it in query order as queries finish */
+	FileOp.openOutputFile(outputFilePath, avgOutput);
+	runBatch(queryBatch, [this](const string &block) { FileOp.writeOutput(block); });
+
+	/* close output file */
+	FileOp.closeOutputFile();
+	if (metricsFilePath != "")
+	{
+		metrics.write(metricsFilePath);
+	}
+}
+
+/*
+	function for scoring a batch of queries against the loaded reference and streaming the results, only reads the
+	reference so several batches can run on the same object at once
+
+	@param queryBatch	=> queries and reporting settings of the run
+	@param output		=> called with each query's formatted block in query order
+ */
+void OffTarget::runBatch(const QueryBatch &queryBatch, const function<void(const string &)> &output)
+{
+	/* vars */
+	int seqLength = endoData[4];
+	unsigned long queryCount = queryBatch.queryScores.size();
+	bool avgOutput = queryBatch.avgOutput;
+	uint64_t runStart = Metrics::now();
+	vector<unique_ptr<HitArena> > arenas(max(1, threadCount));
+	ThreadPool pool(threadCount);
+	vector<QueryData> queries(queryCount);
+
+	/*
+		queries are scanned in batches: each task loads a cache sized tile of reference targets and compares it against
+		every query of its batch before moving to the next tile, so a batch costs one pass over the reference in memory
+	*/
+	unsigned long batchSize = useSeedIndex || useFmIndex ? 1 : tileQueries;
+	if (batchSize == 0)
+	{
+		batchSize = min(32UL, max(1UL, (queryCount + 2UL * pool.size() - 1) / (2UL * pool.size())));
+	}
+	unsigned long batchCount = (queryCount + batchSize - 1) / batchSize;
+	unsigned long tileSize = tileTargets;
+	if (tileSize == 0)
+	{
+		tileSize = max((unsigned long)KERNEL_BLOCK_SIZE, getCacheSize() / 2 / (PackedSequences::wordsFor(seqLength) * sizeof(uint64_t)));
+	}
+
+	/* an index search covers the whole store at once, so candidate mode scans its range as a single tile */
+	if (useSeedIndex || useFmIndex)
+	{
+		tileSize = max(1UL, max(uniqueSeqs.size(), repeatSeqs.size()));
+	}
+
+	/* with fewer batches than workers each batch's scans are split into reference ranges so every core has work */
+	unsigned long rangesPerBatch = max(1UL, (2UL * pool.size() + batchCount - 1) / batchCount);
+	unsigned long uniqueRanges = useSeedIndex || useFmIndex ? 1 : max(1UL, min(rangesPerBatch, uniqueSeqs.size() / MIN_TARGETS_PER_TASK));
+	unsigned long repeatRanges = useSeedIndex || useFmIndex ? 1 : max(1UL, min(rangesPerBatch, repeatSeqs.size() / MIN_TARGETS_PER_TASK));
+	unsigned long taskCount = uniqueRanges + repeatRanges;
+
+	/* init multi-threading variables: at most maxInFlight queries hold results */
+	unsigned long maxInFlight = max(2UL * pool.size(), 2 * batchSize);
+	vector<unique_ptr<QueryResults> > results(queryCount);
+
+	/* each worker's hits grow from its own arena, the chunks are recycled as queries are written and freed together */
+	for (unsigned long a = 0; a < arenas.size(); a++)
+	{
+		arenas[a].reset(new HitArena());
+	}
+
+	/* pack query sequences so they can be compared word by word against the reference stores */
+	for (unsigned long i = 0; i < queryCount; i++)
+	{
+		setQuerySeq(queryBatch.querySeqs.substr(i * seqLength, seqLength), queries[i]);
+		queries[i].qgramSignature = QGramFilter::signature(queries[i].packedSeq.data(), seqLength);
+		queries[i].threshold = queryBatch.threshold;
+		queries[i].topK = queryBatch.topK;
+
+		/* (reference score / query score)^2 for every possible reference score */
+		for (int refScore = 0; refScore < 256; refScore++)
+		{
+			queries[i].ratioTerms[refScore] = pow(double(refScore) / double(queryBatch.queryScores[i]), 2);
+		}
+	}
+
+	/* blocks are streamed to the output in query order as queries finish */
+	OrderedWriter writer([this, &output](const string &block)
+	{
+		uint64_t start = Metrics::now();
+		output(block);
+		metrics.addTime(Metrics::WRITE_OUTPUT, start);
+		metrics.add(Metrics::BYTES_WRITTEN, block.size());
+	}, maxInFlight);
+
+	/* called by the task finishing a query: merges and formats its hits on the worker, then hands them to the writer */
+	auto finishQuery = [&](unsigned long i)
+	{
+		unique_ptr<QueryResults> query(move(results[i]));
+		vector<HitBuffer> merged(2);
+		HitList hits;
+		string currentQuerySeq = queryBatch.querySeqs.substr(i * seqLength, seqLength);
+
+		/* link the hits of the range tasks in task order so they stay in reference order, unique hits first */
+		for (unsigned long t = 0; t < taskCount; t++)
+		{
+			HitBuffer &source = merged[t < uniqueRanges ? 0 : 1];
+			hits.splice(query->hits[t].hits);
+			source.scoreSum += query->hits[t].scoreSum;
+			source.hitCount += query->hits[t].hitCount;
+			source.examined += query->hits[t].examined;
+			source.skipped += query->hits[t].skipped;
+			source.filtered += query->hits[t].filtered;
+			source.candidates += query->hits[t].candidates;
+			source.scored += query->hits[t].scored;
+			source.pruned += query->hits[t].pruned;
+		}
+		query.reset();
+		if (queryBatch.topK > 0)
+		{
+			keepTopHits(hits, queryBatch.topK);
+		}
+		metrics.add(Metrics::TARGETS_EXAMINED, merged[0].examined + merged[1].examined);
+		metrics.add(Metrics::TARGETS_SKIPPED, merged[0].skipped + merged[1].skipped);
+		metrics.add(Metrics::TARGETS_FILTERED, merged[0].filtered + merged[1].filtered);
+		metrics.add(Metrics::CANDIDATES, merged[0].candidates + merged[1].candidates);
+		metrics.add(Metrics::HITS_SCORED, merged[0].scored + merged[1].scored);
+		metrics.add(Metrics::HITS_PRUNED, merged[0].pruned + merged[1].pruned);
+		metrics.add(Metrics::HITS_REPORTED, hits.size());
+		metrics.add(Metrics::QUERIES, 1);
+
+		/* the chunks are formatted in place and go back to their arenas for the next queries */
+		uint64_t start = Metrics::now();
+		string block = queryBatch.shardOutput ? formatShardResults(merged, hits, avgOutput) : FileOp.formatResults(avgOutput, currentQuerySeq, getAverageScore(merged, hits, queryBatch.topK), hits, repeatLocations, repeatSeqs, uniqueLocations, uniqueSeqs);
+		hits.release();
+		metrics.addTime(Metrics::FORMAT_OUTPUT, start);
+		writer.submit(i, move(block));
+	};
+
+	/* score each batch of query sequences as a set of range tasks against the unique and repeat stores */
+	for (unsigned long batch = 0; batch < batchCount; batch++)
+	{
+		unsigned long firstQuery = batch * batchSize;
+		unsigned long lastQuery = min(queryCount, firstQuery + batchSize);
+		writer.waitForRoom(lastQuery - 1);
+		for (unsigned long i = firstQuery; i < lastQuery; i++)
+		{
+			results[i].reset(new QueryResults());
+			results[i]->hits.resize(taskCount);
+			results[i]->remainingTasks = taskCount;
+		}
+
+		for (unsigned long t = 0; t < taskCount; t++)
+		{
+			pool.submit([this, &results, &queries, &arenas, &finishQuery, firstQuery, lastQuery, t, uniqueRanges, repeatRanges, tileSize]()
+			{
+				int source = t < uniqueRanges ? 0 : 1;
+				uint64_t start = Metrics::now();
+				unsigned long range = source == 0 ? t : t - uniqueRanges;
+				unsigned long ranges = source == 0 ? uniqueRanges : repeatRanges;
+				unsigned long size = source == 0 ? uniqueSeqs.size() : repeatSeqs.size();
+				unsigned long last = size * (range + 1) / ranges;
+				for (unsigned long i = firstQuery; i < lastQuery; i++)
+				{
+					results[i]->hits[t].arena = arenas[ThreadPool::getWorkerIndex()].get();
+					results[i]->hits[t].source = source;
+				}
+
+				/* compare each tile of the range against every query of the batch while it is in cache */
+				for (unsigned long tile = size * range / ranges; tile < last; tile += tileSize)
+				{
+					for (unsigned long i = firstQuery; i < lastQuery; i++)
+					{
+						findSimilars(queries[i], source, tile, min(last, tile + tileSize), results[i]->hits[t]);
+					}
+				}
+				metrics.addTime(source == 0 ? Metrics::UNIQUE_SCAN : Metrics::REPEAT_SCAN, start);
+
+				for (unsigned long i = firstQuery; i < lastQuery; i++)
+				{
+					if (queries[i].topK > 0)
+					{
+						flushTopHits(results[i]->hits[t]);
+					}
+					if (--results[i]->remainingTasks == 0)
+					{
+						finishQuery(i);
+					}
+				}
+			});
+		}
+	}
+
+	/* wait for the last queries to be scored and written */
+	pool.wait();
+	metrics.addThreadTimes(pool.getBusyTimes(), Metrics::now() - runStart);
+}
+
+/*
+	function for running the OffTarget algorithm split across shardCount worker processes
+
+	This process only parses CASPERinfo and the queries, and counts the seed groups of the repeats DB when the workers
+	will parse it so none of them reads the whole table. Each worker is forked while no thread is running, loads its
+	shard of the reference and streams the hits of every query back over a pipe, and the hits of each query are merged
+	in shard order and written exactly as a single process run writes them.
+ */
+void OffTarget::runShards()
+{
+#ifdef _WIN32
+	cerr << "Shard mode is not supported on this platform." << endl;
+	exit(-1);
+#else
+	/* vars */
+	vector<FILE *> shards(shardCount);
+	vector<pid_t> workers(shardCount);
+
+	uint64_t start = Metrics::now();
+	FileOp.parseEndoData(casperInfoFilePath, endo, endoData);
+	metrics.addTime(Metrics::PARSE_CASPERINFO, start);
+	start = Metrics::now();
+	FileOp.parseQueryFile(queryFilePath, querySeqs, queryScores);
+	metrics.addTime(Metrics::PARSE_QUERIES, start);
+	int seqLength = endoData[4];
+
+	/* workers parsing the DB find their window of the seed groups from counts taken once here, before any fork */
+	if (indexFilePath == "" && !useSharedMemory)
+	{
+		start = Metrics::now();
+		FileOp.countSqlGroups(sqlFilePath, threadCount, repeatRowidRanges);
+		metrics.addTime(Metrics::PARSE_REPEATS, start);
+	}
+
+	cout.flush();
+	for (int s = 0; s < shardCount; s++)
+	{
+		int fds[2];
+		if (pipe(fds) != 0 || (workers[s] = fork()) < 0)
+		{
+			cerr << "Shard worker " << s << " couldn't be started." << endl;
+			exit(-1);
+		}
+		if (workers[s] == 0)
+		{
+			close(fds[0]);
+			for (int p = 0; p < s; p++)
+			{
+				fclose(shards[p]);
+			}
+			runShardWorker(s, fds[1]);
+			sharedReference.close();
+			_exit(0);
+		}
+		close(fds[1]);
+		shards[s] = fdopen(fds[0], "rb");
+	}
+
+	/* merge the hits of each query in shard order, which keeps them in reference order */
+	HitArena arena;
+	FileOp.openOutputFile(outputFilePath, avgOutput);
+	for (unsigned long i = 0; i < queryScores.size(); i++)
+	{
+		vector<HitBuffer> merged(2);
+		vector<vector<string> > lines(2);
+		HitList hits;
+		string currentQuerySeq = querySeqs.substr(i * seqLength, seqLength);
+
+		for (int s = 0; s < shardCount; s++)
+		{
+			if (!readShardResults(shards[s], merged, lines, arena))
+			{
+				cerr << "Shard worker " << s << " failed." << endl;
+				exit(-1);
+			}
+		}
+		hits.splice(merged[0].hits);
+		hits.splice(merged[1].hits);
+		if (topK > 0)
+		{
+			keepTopHits(hits, topK);
+		}
+		metrics.add(Metrics::HITS_REPORTED, hits.size());
+		metrics.add(Metrics::QUERIES, 1);
+
+		start = Metrics::now();
+		string block = FileOp.formatMergedResults(avgOutput, currentQuerySeq, getAverageScore(merged, hits, topK), hits, lines);
+		metrics.addTime(Metrics::FORMAT_OUTPUT, start);
+		start = Metrics::now();
+		FileOp.writeOutput(block);
+		metrics.addTime(Metrics::WRITE_OUTPUT, start);
+		metrics.add(Metrics::BYTES_WRITTEN, block.size());
+	}
+	FileOp.closeOutputFile();
+
+	for (int s = 0; s < shardCount; s++)
+	{
+		int status = 0;
+		fclose(shards[s]);
+		if (waitpid(workers[s], &status, 0) != workers[s] || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		{
+			cerr << "Shard worker " << s << " failed." << endl;
+			exit(-1);
+		}
+	}
+	if (metricsFilePath != "")
+	{
+		metrics.write(metricsFilePath);
+	}
+#endif
+}
+
+/*
+	function run by a forked shard worker: loads its shard of the reference and streams the hits of every query
+
+	@param shard	=> index of the worker's shard
+	@param fd		=> write end of the pipe to the coordinator, closed when every query is written
+ */
+void OffTarget::runShardWorker(int shard, int fd)
+{
+#ifndef _WIN32
+	/* vars */
+	QueryBatch queryBatch;
+
+	/* the workers share the thread count */
+	shardIndex = shard;
+	threadCount = max(1, threadCount / shardCount);
+	loadReference();
+
+	queryBatch.querySeqs = querySeqs;
+	queryBatch.queryScores = queryScores;
+	queryBatch.threshold = threshold;
+	queryBatch.topK = topK;
+	queryBatch.avgOutput = avgOutput;
+	queryBatch.shardOutput = true;
+	runBatch(queryBatch, [fd](const string &block)
+	{
+		unsigned long written = 0;
+		while (written < block.size())
+		{
+			ssize_t count = write(fd, block.data() + written, block.size() - written);
+			if (count < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (count <= 0)
+			{
+				/* the coordinator is gone */
+				_exit(-1);
+			}
+			written += count;
+		}
+	});
+	close(fd);
+
+	/* each worker reports its own load and scans next to the coordinator's report */
+	if (metricsFilePath != "")
+	{
+		metrics.write(metricsFilePath + ".shard" + to_string(shard));
+	}
+#endif
 }
 
 /*
-	function for calling file operations object to parse data needed for algorithm:
-*/
-void OffTarget::getAlgorithmData()
+	function to encode the hits of a query found by a shard worker for the coordinator
+
+	For the unique and then the repeat hits: hit count, score sum and number of hits kept, then the score and the
+	formatted remainder of the output line of each hit kept.
+
+	@param merged		=> unique and repeat hit counts of the query
+	@param hits			=> hits of the query, unique hits then repeat hits
+	@param avgOutput	=> true if the output lines of the hits are not written
+
+	@return record	=> encoded hits of the query
+ */
+string OffTarget::formatShardResults(vector<HitBuffer> &merged, HitList &hits, bool avgOutput)
 {
-	FileOp.parseCasperInfo(casperInfoFilePath, endo, endoData, hsuMatrixName, hsuMatrix);
-	FileOp.parseCsprFile(csprFilePath, uniqueSeqs, uniqueScores, uniqueLocations, uniqueChroms);
-	FileOp.parseSqlFile(sqlFilePath, repeatSeqs, repeatScores, repeatLocations, repeatChroms);
-	FileOp.parseQueryFile(queryFilePath, querySeqs, queryScores);
+	/* vars */
+	string record;
+	ostringstream line;
+	uint64_t kept[2] = { 0, 0 };
+	const HitChunk *chunk = hits.getFirstChunk();
+	int r = 0;
 
-	//store three prime
-	if (endoData[5] == 3)
+	for (const HitChunk *c = chunk; c != nullptr; c = c->next)
 	{
-		three_prime = true;
+		for (int h = 0; h < c->count; h++)
+		{
+			kept[c->records[h].source]++;
+		}
 	}
-	else
+
+	/* the repeat hits follow the unique ones, so the list is read once across both sources */
+	for (int source = 0; source < 2; source++)
 	{
-		three_prime = false;
+		PackedSequences &refSeqs = source == 0 ? uniqueSeqs : repeatSeqs;
+		LocationColumn &refLocations = source == 0 ? uniqueLocations : repeatLocations;
+
+		record.append((const char *)&merged[source].hitCount, sizeof(uint64_t));
+		record.append((const char *)&merged[source].scoreSum, sizeof(double));
+		record.append((const char *)&kept[source], sizeof(uint64_t));
+		for (uint64_t h = 0; h < kept[source]; h++, r++)
+		{
+			if (r == chunk->count)
+			{
+				chunk = chunk->next;
+				r = 0;
+			}
+			const HitRecord &hit = chunk->records[r];
+			line.str("");
+			if (!avgOutput)
+			{
+				line << "," << refLocations.getChrom(hit.index) << "," << refLocations.getLocation(hit.index) << "," << refSeqs.unpack(hit.index);
+			}
+			uint32_t length = line.str().size();
+			record.append((const char *)&hit.score, sizeof(double));
+			record.append((const char *)&length, sizeof(uint32_t));
+			record.append(line.str());
+		}
 	}
+	return record;
 }
 
-/* 
-	function for running the OffTarget algorithm
+/*
+	function to read the hits of a query sent by a shard worker and append them to the query's merged hits
+
+	The index of each hit is the position of its line in the merged lines of its source, which is its rank in reference
+	order.
+
+	@param shard	=> stream of the worker's pipe
+	@param merged	=> unique and repeat hit buffers of the query
+	@param lines	=> formatted remainder of the output line of each merged unique and repeat hit
+	@param arena	=> arena the hit lists grow from
+
+	@return true	=> the hits were read
+	@return false	=> the worker's stream ended early
  */
-void OffTarget::run()
+bool OffTarget::readShardResults(FILE *shard, vector<HitBuffer> &merged, vector<vector<string> > &lines, HitArena &arena)
+{
+	for (int source = 0; source < 2; source++)
+	{
+		uint64_t hitCount, kept;
+		double scoreSum;
+		if (fread(&hitCount, sizeof(uint64_t), 1, shard) != 1 || fread(&scoreSum, sizeof(double), 1, shard) != 1 || fread(&kept, sizeof(uint64_t), 1, shard) != 1)
+		{
+			return false;
+		}
+		merged[source].hitCount += hitCount;
+		merged[source].scoreSum += scoreSum;
+		for (uint64_t h = 0; h < kept; h++)
+		{
+			double hitScore;
+			uint32_t length;
+			if (fread(&hitScore, sizeof(double), 1, shard) != 1 || fread(&length, sizeof(uint32_t), 1, shard) != 1)
+			{
+				return false;
+			}
+			string line(length, '\0');
+			if (length > 0 && fread(&line[0], 1, length, shard) != length)
+			{
+				return false;
+			}
+			HitRecord hit = { hitScore, lines[source].size(), (uint64_t)source };
+			merged[source].hits.push_back(arena, hit);
+			lines[source].push_back(line);
+		}
+	}
+	return true;
+}
+
+/*
+	function to get the size of the per core cache used to size reference tiles
+
+	@return size of the level 2 data cache in bytes, 1 MB if it can't be determined
+ */
+unsigned long OffTarget::getCacheSize()
+{
+	unsigned long size = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+	long reported = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	if (reported > 0)
+	{
+		size = (unsigned long)reported;
+	}
+#endif
+	return size > 0 ? size : 1UL << 20;
+}
+
+/*
+	function to drop all but the topK best scoring hits of a hit list
+
+	Hits are ranked by score, ties go to the unique hits and then the lower index, so the hits kept do not depend on
+	how the scans were split into tasks. The hits kept stay in their original order and the score sums and hit counts
+	are left untouched for the average score.
+
+	@param hits		=> hit list to trim
+	@param topK		=> number of hits to keep
+ */
+void OffTarget::keepTopHits(HitList &hits, unsigned long topK)
 {
 	/* vars */
-	int seqLength = endoData[4];
-	string currentQuerySeq = "", details = "\n";
-	vector<double> targets;
-	int threadCount = queryScores.size();
-	vector<thread> runningThreads(threadCount);
-	int currentQueryScore = 0;
-	
-	/* init multi-threading variables */
-	vector<vector<vector<double> > > targetScores(queryScores.size(), vector<vector<double> >(2));
-	vector<vector<vector<unsigned long > > > targetIndexes( queryScores.size(), vector<vector<unsigned long> >(2));
-	
-	/* open output file object so findSimilars can write out results*/
-	FileOp.openOutputFile(outputFilePath, avgOutput);
-	/* score each query sequence and write out the results in a thread */
-	for (unsigned long i = 0; i < queryScores.size(); i++)
+	vector<RankedHit> ranked;
+
+	if (hits.size() <= topK)
 	{
-		/* get current query variables for thread */
-		currentQuerySeq = querySeqs.substr(i * seqLength, seqLength);
-		currentQueryScore = queryScores[i];
-		
-		/* create thread */
-		thread t([this, currentQuerySeq, currentQueryScore, &targetScores, &targetIndexes, i]()
-		{ 
-			findSimilars(currentQuerySeq, currentQueryScore, targetScores[i], targetIndexes[i]); 
-		});
+		return;
+	}
+	ranked.reserve(hits.size());
+	for (const HitChunk *chunk = hits.getFirstChunk(); chunk != nullptr; chunk = chunk->next)
+	{
+		for (int r = 0; r < chunk->count; r++)
+		{
+			RankedHit hit = { chunk->records[r], ranked.size() };
+			ranked.push_back(hit);
+		}
+	}
+
+	nth_element(ranked.begin(), ranked.begin() + topK, ranked.end(), [](const RankedHit &x, const RankedHit &y)
+	{
+		return ranksBefore(x.hit, y.hit);
+	});
 
-		/* save thread */
-		runningThreads[i] = move(t);
+	/* keep the first topK ranked hits in their original order */
+	vector<bool> keep(hits.size(), false);
+	for (unsigned long r = 0; r < topK; r++)
+	{
+		keep[ranked[r].position] = true;
 	}
+	hits.keep(keep);
+}
+
+/*
+	function to offer a hit to the bounded heap of the topK best hits of a task
+
+	The heap holds at most topK hits with the worst ranked one in front, a new hit replaces it if it ranks before it.
+	A task never holds more than topK hits however many it finds.
 
-	/* join threads and write out data to file */
-	for (unsigned long i = 0; i < runningThreads.size(); i++)
+	@param hits		=> buffer of the task
+	@param hit		=> hit found
+	@param topK		=> number of hits to keep
+ */
+void OffTarget::addTopHit(HitBuffer &hits, const HitRecord &hit, unsigned long topK)
+{
+	auto heapOrder = [](const RankedHit &x, const RankedHit &y) { return ranksBefore(x.hit, y.hit); };
+	RankedHit ranked = { hit, hits.hitCount };
+
+	if (hits.topHits.size() < topK)
+	{
+		hits.topHits.push_back(ranked);
+		push_heap(hits.topHits.begin(), hits.topHits.end(), heapOrder);
+	}
+	else if (ranksBefore(hit, hits.topHits.front().hit))
 	{
-		runningThreads[i].join();
-		currentQuerySeq = querySeqs.substr(i * seqLength, seqLength);
+		pop_heap(hits.topHits.begin(), hits.topHits.end(), heapOrder);
+		hits.topHits.back() = ranked;
+		push_heap(hits.topHits.begin(), hits.topHits.end(), heapOrder);
+	}
+}
+
+/*
+	function to move the best hits of a task from its heap to its hit list
 
-		/* write findings */
-		FileOp.writeResults(avgOutput, currentQuerySeq, targetScores[i][0], targetIndexes[i][0], targetScores[i][1], targetIndexes[i][1], repeatLocations, repeatChroms, repeatSeqs, uniqueLocations, uniqueChroms, uniqueSeqs, seqLength);
-		
-		/* clear out data */
-		targetScores[i].clear();
-		targetScores[i].shrink_to_fit();
-		targetIndexes[i].clear();
-		targetIndexes[i].shrink_to_fit();
+	@param hits		=> buffer of the task, its heap is emptied
+ */
+void OffTarget::flushTopHits(HitBuffer &hits)
+{
+	sort(hits.topHits.begin(), hits.topHits.end(), [](const RankedHit &x, const RankedHit &y)
+	{
+		return x.position < y.position;
+	});
+	for (unsigned long h = 0; h < hits.topHits.size(); h++)
+	{
+		hits.hits.push_back(*hits.arena, hits.topHits[h].hit);
 	}
+	hits.topHits.clear();
+	hits.topHits.shrink_to_fit();
+}
 
-	/* close output file */
-	FileOp.closeOutputFile();
+/*
+	function to rank two hits in top-K mode: by score, ties go to the unique hits and then the lower index
+
+	@return true	=> hit x ranks before hit y
+ */
+bool OffTarget::ranksBefore(const HitRecord &x, const HitRecord &y)
+{
+	if (x.score != y.score)
+	{
+		return x.score > y.score;
+	}
+	return x.source != y.source ? x.source < y.source : x.index < y.index;
 }
 
 /*
-	OffTarget function for finding similar sequences in the reference organism, scoring the findings, and writing out the results
+	function to get the average score of a query's hits
+
+	Without top-K every hit is still in the list and the average is summed in reference order, the unique hits and
+	the repeat hits apart and then added. In top-K mode the sums kept while scanning are used since the dropped hits
+	still count.
+
+	@param merged	=> unique and repeat hit counts of the query
+	@param hits		=> hits of the query
+	@param topK		=> top-K setting of the run, 0 if every hit is kept
 
-	@param currentQuerySeq		=> current query sequence being analyzed
-	@param currentQueryScore	=> on-target score of query sequence
-	@param targetScores			=> vector that gets filled with individual scores from targets found in this function
-	@param targetIndexes		=> vector that gets filled with the index values of target sequences found
+	@return averageScore	=> average score of all hits reported for the query, 0 if there are none
  */
-void OffTarget::findSimilars(string currentQuerySeq, int currentQueryScore, vector<vector<double> > &targetScores, vector<vector<unsigned long> > &targetIndexes)
+double OffTarget::getAverageScore(vector<HitBuffer> &merged, HitList &hits, unsigned long topK)
 {
-	//vars
-	int seqLength = endoData[4];
+	double averageScore = 0.0;
+	unsigned long hitCount = merged[0].hitCount + merged[1].hitCount;
+
+	if (topK == 0)
+	{
+		double sums[2] = { 0.0, 0.0 };
+		for (const HitChunk *chunk = hits.getFirstChunk(); chunk != nullptr; chunk = chunk->next)
+		{
+			for (int r = 0; r < chunk->count; r++)
+			{
+				sums[chunk->records[r].source] += chunk->records[r].score;
+			}
+		}
+		averageScore = sums[0] + sums[1];
+	}
+	else
+	{
+		averageScore = merged[0].scoreSum + merged[1].scoreSum;
+	}
+	if (hitCount != 0)
+	{
+		averageScore /= hitCount;
+	}
+	return averageScore;
+}
 
-	/* run query sequence against unique sequences from CSPR file */
-	findSimilarsUnique(currentQuerySeq, currentQueryScore, seqLength, targetScores[0], targetIndexes[0]);
+/*
+	OffTarget function for finding similar sequences in one range of the reference organism and scoring the findings
+	findSimilars is a wrapper for calling findSimilarsUnique or findSimilarsRepeat for a range task of a query sequence
 
-	/* run query sequence against repeat sequences from DB file */
-	findSimilarsRepeat(currentQuerySeq, currentQueryScore, seqLength, targetScores[1], targetIndexes[1]);
+	@param query			=> packed sequence, score and ratio terms of the query being analyzed
+	@param source			=> 0 for the unique sequences, 1 for the repeat sequences
+	@param first			=> index of the first target of the range
+	@param last				=> index one past the last target of the range
+	@param hits			=> buffer that gets filled with the scores and indexes of targets found in this function
+ */
+void OffTarget::findSimilars(const QueryData &query, int source, unsigned long first, unsigned long last, HitBuffer &hits)
+{
+	if (source == 0)
+	{
+		/* run query sequence against unique sequences from CSPR file */
+		findSimilarsUnique(query, first, last, hits);
+	}
+	else
+	{
+		/* run query sequence against repeat sequences from DB file */
+		findSimilarsRepeat(query, first, last, hits);
+	}
 }
 
 /*
 	function for running off target analysis of query sequence against the unique organism data from CSPR file
 
-	@param currentQuerySeq		=> current query sequence string
-	@param currentQueryScore	=> on-score of current query string
-	@param seqLength			=> length of sequences for current endo
-	@param targetScores			=> vector that gets filled with individual scores from targets found in this function
-	@param targetIndexes		=> vector that gets filled with the index values of target sequences found
+	@param query			=> packed sequence, score and ratio terms of the current query
+	@param first			=> index of the first target to compare
+	@param last				=> index one past the last target to compare
+	@param hits			=> buffer that gets filled with the scores and indexes of targets found in this function
 
 */
-void OffTarget::findSimilarsUnique(string &currentQuerySeq, int &currentQueryScore, int &seqLength, vector<double> &targetScores, vector<unsigned long> &targetIndexes)
+void OffTarget::findSimilarsUnique(const QueryData &query, unsigned long first, unsigned long last, HitBuffer &hits)
 {	
-	/* vars */
-	double rRatio = 0.0;
-	double value = 0.0;
-	string refSeq;
+	/* exact matches are the query itself and are skipped */
+	if (useSeedIndex || useFmIndex)
+	{
+		vector<unsigned long> candidates;
+		getCandidates(query, 0, first, last, candidates);
+		compareCandidates(uniqueSeqs, uniqueScores, candidates, true, query, hits);
+	}
+	else
+	{
+		compareRange(uniqueSeqs, uniqueScores, uniqueFilter, first, last, true, query, hits);
+	}
+}
+
+/* 
+	function for running off target analysis of query sequence against the repeat organism data from DB file
 
-	/* loop through each organims unique seq from CSPR file and compare against the given query sequence */
-	for (unsigned long i = 0; i < uniqueSeqs.length() / seqLength; i++)
+	@param query			=> packed sequence, score and ratio terms of the current query
+	@param first			=> index of the first target to compare
+	@param last				=> index one past the last target to compare
+	@param hits			=> buffer that gets filled with the scores and indexes of targets found in this function
+*/
+void OffTarget::findSimilarsRepeat(const QueryData &query, unsigned long first, unsigned long last, HitBuffer &hits)
+{
+	if (useSeedIndex || useFmIndex)
+	{
+		vector<unsigned long> candidates;
+		getCandidates(query, 1, first, last, candidates);
+		compareCandidates(repeatSeqs, repeatScores, candidates, false, query, hits);
+	}
+	else
 	{
-		vector<int> mismatches;
-		vector<string> mismatchKeys;
-		rRatio = double(uniqueScores[i]) / double(currentQueryScore);
-		refSeq = uniqueSeqs.substr(i * seqLength, seqLength);
+		compareGroups(first, last, query, hits);
+	}
+}
 
-		//character by character comparison of ref and query sequences
-		if (refSeq != currentQuerySeq && getMismatches(refSeq, currentQuerySeq, mismatches, mismatchKeys, seqLength))
-		{
-			targetIndexes.push_back(i);
+/*
+	function to collect the candidate targets of a range task from the seed or FM index of its reference store
+
+	@param query			=> packed sequence, score and ratio terms of the current query
+	@param source			=> 0 for the unique sequences, 1 for the repeat sequences
+	@param first			=> index of the first target of the range
+	@param last				=> index one past the last target of the range
+	@param candidates		=> filled with the candidates in [first, last) in ascending order
+ */
+void OffTarget::getCandidates(const QueryData &query, int source, unsigned long first, unsigned long last, vector<unsigned long> &candidates)
+{
+	if (useFmIndex)
+	{
+		(source == 0 ? uniqueFmIndex : repeatFmIndex).getCandidates(query.packedSeq.data(), candidates);
+	}
+	else
+	{
+		(source == 0 ? uniqueIndex : repeatIndex).getCandidates(query.packedSeq.data(), candidates);
+	}
+	candidates.erase(lower_bound(candidates.begin(), candidates.end(), last), candidates.end());
+	candidates.erase(candidates.begin(), lower_bound(candidates.begin(), candidates.end(), first));
+}
+
+/*
+	function for comparing a range of the repeat store against the query a seed group at a time
 
-			double st_score = score.stScore(mismatches);
-			double sh_score = score.shScore(mismatches, mismatchKeys, hsuMatrix, seqLength);
-			double ss_score = score.ssScore(mismatches, seqLength);
+	The repeats of a group share their seed, so a group whose seed alone has more than maxMismatches mismatches
+	against the query is skipped without comparing any of its targets. The targets of the remaining groups are
+	compared in runs of consecutive groups.
+
+	@param first			=> index of the first target to compare
+	@param last				=> index one past the last target to compare
+	@param query			=> packed sequence, score and ratio terms of the current query
+	@param hits			=> buffer that gets filled with the scores and indexes of targets found in this function
+ */
+void OffTarget::compareGroups(unsigned long first, unsigned long last, const QueryData &query, HitBuffer &hits)
+{
+	/* vars */
+	unsigned long groupCount = repeatGroups.size();
+	unsigned long runStart = first;
+
+	/* the group holding the first target, the range may start part way through it */
+	unsigned long lowGroup = 0, highGroup = groupCount;
+	while (lowGroup < highGroup)
+	{
+		unsigned long middle = (lowGroup + highGroup) / 2;
+		if (repeatGroups[middle].first <= first)
+		{
+			lowGroup = middle + 1;
+		}
+		else
+		{
+			highGroup = middle;
+		}
+	}
 
-			value = (sqrt(sh_score) + st_score) * (pow(rRatio, 2)) * (pow(ss_score, 6));
-			value /= 4;
-			
-			targetScores.push_back(value / 2);
+	for (unsigned long g = lowGroup == 0 ? 0 : lowGroup - 1; g < groupCount && repeatGroups[g].first < last; g++)
+	{
+		unsigned long groupFirst = max(first, (unsigned long)repeatGroups[g].first);
+		unsigned long groupLast = min(last, g + 1 < groupCount ? (unsigned long)repeatGroups[g + 1].first : repeatSeqs.size());
+		if (PackedSequences::spanMismatches(repeatSeqs.getSequence(groupFirst), query.packedSeq.data(), endoData[4], repeatGroups[g].seedStart, repeatGroups[g].seedLength) > maxMismatches)
+		{
+			hits.skipped += groupLast - groupFirst;
+			if (runStart < groupFirst)
+			{
+				compareRange(repeatSeqs, repeatScores, repeatFilter, runStart, groupFirst, false, query, hits);
+			}
+			runStart = groupLast;
 		}
 	}
+	if (runStart < last)
+	{
+		compareRange(repeatSeqs, repeatScores, repeatFilter, runStart, last, false, query, hits);
+	}
 }
 
-/* 
-	function for running off target analysis of query sequence against the repeat organism data from DB file
+/*
+	function for comparing every target in a range of a reference store against the query
 
-	@param currentQuerySeq		=> current query sequence string
-	@param currentQueryScore	=> on-score of current query string
-	@param seqLength			=> length of sequences for current endo
-	@param targetScores			=> vector that gets filled with individual scores from targets found in this function
-	@param targetIndexes		=> vector that gets filled with the index values of target sequences found
-*/
-void OffTarget::findSimilarsRepeat(string &currentQuerySeq, int &currentQueryScore, int &seqLength, vector<double> &targetScores, vector<unsigned long> &targetIndexes)
+	@param refSeqs			=> packed reference store to compare against
+	@param refScores		=> on-target scores of the reference store
+	@param refFilter		=> q-gram filter of the reference store, targets are only rejected by it once it is built
+	@param first			=> index of the first target to compare
+	@param last				=> index one past the last target to compare
+	@param skipExactMatches	=> true if targets without mismatches are not reported
+	@param query			=> packed sequence, score and ratio terms of the current query
+	@param hits			=> buffer that gets filled with the scores and indexes of targets found in this function
+ */
+void OffTarget::compareRange(PackedSequences &refSeqs, Column<uint8_t> &refScores, QGramFilter &refFilter, unsigned long first, unsigned long last, bool skipExactMatches, const QueryData &query, HitBuffer &hits)
 {
 	/* vars */
-	double rRatio = 0.0;
-	double value = 0.0;
-	string refSeq;
+	unsigned long blockIndexes[KERNEL_BLOCK_SIZE];
 
-	/* loop through each organims unique seq from CSPR file and compare against the given query sequence */
-	for (unsigned long i = 0; i < repeatSeqs.length() / seqLength; i++)
+	/* loop through blocks of the range and compare each block against the given query sequence */
+	for (unsigned long block = first; block < last; block += KERNEL_BLOCK_SIZE)
 	{
-		vector<int> mismatches;
-		vector<string> mismatchKeys;
-		rRatio = double(repeatScores[i]) / double(currentQueryScore);
-		refSeq = repeatSeqs.substr(i * seqLength, seqLength);
+		int blockCount = (int)min((unsigned long)KERNEL_BLOCK_SIZE, last - block);
 
-		//character by character comparison of ref and query sequences
-		if (getMismatches(refSeq, currentQuerySeq, mismatches, mismatchKeys, seqLength))
+		/* a block the q-gram filter rejects whole is skipped, the kernel costs as much per target as the filter */
+		if (refFilter.isBuilt() && refFilter.rejects(query.qgramSignature, block, block + blockCount))
+		{
+			hits.filtered += blockCount;
+			continue;
+		}
+		for (int b = 0; b < blockCount; b++)
 		{
-			//update runnning score if mismatch count wasn't too large
-			targetIndexes.push_back(i);
+			blockIndexes[b] = block + b;
+		}
+		(this->*scoreBlock)(refSeqs.getSequence(block), blockIndexes, blockCount, refScores, skipExactMatches, query, hits);
+	}
+}
 
-			double st_score = score.stScore(mismatches);
-			double sh_score = score.shScore(mismatches, mismatchKeys, hsuMatrix, seqLength);
-			double ss_score = score.ssScore(mismatches, seqLength);
+/*
+	function for comparing a sorted list of candidate targets of a reference store against the query
 
-			value = (sqrt(sh_score) + st_score) * (pow(rRatio, 2)) * (pow(ss_score, 6));
-			value /= 4;
+	@param refSeqs			=> packed reference store to compare against
+	@param refScores		=> on-target scores of the reference store
+	@param candidates		=> ascending indexes of the targets to compare
+	@param skipExactMatches	=> true if targets without mismatches are not reported
+	@param query			=> packed sequence, score and ratio terms of the current query
+	@param hits			=> buffer that gets filled with the scores and indexes of targets found in this function
+ */
+void OffTarget::compareCandidates(PackedSequences &refSeqs, Column<uint8_t> &refScores, vector<unsigned long> &candidates, bool skipExactMatches, const QueryData &query, HitBuffer &hits)
+{
+	/* vars */
+	int wordsPerSeq = refSeqs.getWordsPerSeq();
+	vector<uint64_t> blockSeqs(KERNEL_BLOCK_SIZE * wordsPerSeq);
 
-			targetScores.push_back(value / 2);
+	/* gather blocks of candidates next to each other so they can go through the kernel together */
+	for (unsigned long block = 0; block < candidates.size(); block += KERNEL_BLOCK_SIZE)
+	{
+		int blockCount = (int)min((unsigned long)KERNEL_BLOCK_SIZE, candidates.size() - block);
+		for (int b = 0; b < blockCount; b++)
+		{
+			const uint64_t *seq = refSeqs.getSequence(candidates[block + b]);
+			copy(seq, seq + wordsPerSeq, blockSeqs.begin() + b * wordsPerSeq);
 		}
+		(this->*scoreBlock)(blockSeqs.data(), &candidates[block], blockCount, refScores, skipExactMatches, query, hits);
+	}
+}
+
+/*
+	function to pick the scoring kernel specialized for the endo's sequence length and orientation
+
+	@return scoring kernel, the generic one if the sequence length has no specialization
+ */
+OffTarget::ScoreBlockFunction OffTarget::selectScoreBlock()
+{
+	switch (endoData[4])
+	{
+	case 20:
+		return three_prime ? &OffTarget::scoreBlockFor<20, true> : &OffTarget::scoreBlockFor<20, false>;
+	case 24:
+		return three_prime ? &OffTarget::scoreBlockFor<24, true> : &OffTarget::scoreBlockFor<24, false>;
+	default:
+		return three_prime ? &OffTarget::scoreBlockFor<0, true> : &OffTarget::scoreBlockFor<0, false>;
 	}
 }
 
 /*
-	function for character wise comparison of two sequences
+	function for comparing a block of packed targets against the query and scoring the ones within maxMismatches
 
-	@param refSeq				=> sequence pulled from organism CSPR/DB file
-	@param currentQuerySeq		=> sequence pulled from query file
-	@param mismatchLocations	=> vector that will get filled in with the locations the mismatched characters appear at between the two sequences
-	@param mismatchKeys			=> vector that will get filled in with the HSU keys to use with each mismatch location
-	@param seqLength			=> int representing the length of sequences for the current endo
+	SEQ_LENGTH and THREE_PRIME fix the endo geometry at compile time, SEQ_LENGTH 0 reads the length from endoData.
 
-	@return true	=> number of mismatches found not larger than max mismatches allowed
-	@return false	=> otherwise
+	@param blockSeqs		=> packed words of blockCount consecutive targets
+	@param blockIndexes		=> store index of each target in the block
+	@param blockCount		=> number of targets in the block, at most KERNEL_BLOCK_SIZE
+	@param refScores		=> on-target scores of the reference store
+	@param skipExactMatches	=> true if targets without mismatches are not reported
+	@param query			=> packed sequence, score and ratio terms of the current query
+	@param hits			=> buffer that gets filled with the scores and indexes of targets found in this function
  */
-bool OffTarget::getMismatches(string &refSeq, string &currentQuerySeq, vector<int> &mismatchLocations, vector<string> &mismatchKeys, int &seqLength)
+template <int SEQ_LENGTH, bool THREE_PRIME>
+void OffTarget::scoreBlockFor(const uint64_t *blockSeqs, const unsigned long *blockIndexes, int blockCount, Column<uint8_t> &refScores, bool skipExactMatches, const QueryData &query, HitBuffer &hits)
 {
 	/* vars */
-	string hsuKey;
-	
-	if (three_prime)
+	const int seqLength = SEQ_LENGTH > 0 ? SEQ_LENGTH : endoData[4];
+	const int wordsPerSeq = PackedSequences::wordsFor(seqLength);
+	uint8_t counts[KERNEL_BLOCK_SIZE];
+	uint64_t masks[KERNEL_BLOCK_SIZE * KERNEL_MAX_WORDS];
+	int mismatches[MAX_MISMATCH_POSITIONS];
+	uint8_t mismatchKeys[MAX_MISMATCH_POSITIONS];
+
+	kernel.compare(blockSeqs, query.packedSeq.data(), wordsPerSeq, blockCount, counts, masks);
+	hits.examined += blockCount;
+
+	/* the packed compare sees bases other than ACGT as A, which only ever undercounts, so the filters before it hold */
+	const PackedSequences &refSeqs = hits.source == 0 ? uniqueSeqs : repeatSeqs;
+	if (query.ambiguous || refSeqs.getAmbiguousIndexes().size() > 0)
+	{
+		countAmbiguous(refSeqs, blockIndexes, blockCount, query, counts, masks);
+	}
+
+	for (int b = 0; b < blockCount; b++)
 	{
-		for (int j = seqLength - 1; j >= 0; j--)
+		/* skip targets with too many mismatches */
+		if (counts[b] > maxMismatches || (skipExactMatches && counts[b] == 0))
 		{
-			if (refSeq.at(j) != currentQuerySeq.at(j))
-			{
-				//store mismatch location
-				mismatchLocations.push_back(seqLength - j);
-				//store key for HSU matrix
-				hsuKey = string() + refSeq.at(j) + reverseComp(currentQuerySeq.at(j));
-				mismatchKeys.push_back(hsuKey);
-			}
+			continue;
 		}
-		/* if there are too many mismatches, break */
-		if (mismatchLocations.size() > maxMismatches)
+
+		/* skip targets whose best possible score for their mismatch count is below the threshold */
+		hits.candidates++;
+		unsigned long i = blockIndexes[b];
+		double ratioTerm = query.ratioTerms[refScores[i]];
+		if (query.threshold > 0 && score.scoreBound(counts[b]) * ratioTerm < query.threshold)
 		{
-			return false;
+			hits.pruned++;
+			continue;
+		}
+
+		/* only the targets left get their mismatch positions extracted, into buffers reused for every target */
+		int mismatchCount = getMismatches<SEQ_LENGTH, THREE_PRIME>(&masks[b * wordsPerSeq], blockSeqs + b * wordsPerSeq, query.packedSeq.data(), mismatches, mismatchKeys);
+		double value = score.offTargetScore(mismatches, mismatchKeys, mismatchCount, ratioTerm);
+		hits.scored++;
+		if (query.threshold > 0 && value < query.threshold)
+		{
+			hits.pruned++;
+			continue;
+		}
+
+		HitRecord hit = { value, i, (uint64_t)hits.source };
+		if (query.topK > 0)
+		{
+			addTopHit(hits, hit, query.topK);
 		}
+		else
+		{
+			hits.hits.push_back(*hits.arena, hit);
+		}
+		hits.scoreSum += value;
+		hits.hitCount++;
 	}
-	else
+}
+
+/*
+	function to count the mismatches of bases other than ACGT in a block compared by the kernel as a character compare does
+
+	A position of a recorded target mismatches where its character differs from the query's, a position of any other
+	target mismatches where the query holds a base other than ACGT. The HSU key of such a mismatch is the one of the
+	bases as packed.
+
+	@param refSeqs		=> reference store the block was taken from
+	@param blockIndexes	=> ascending store index of each target in the block
+	@param blockCount	=> number of targets in the block
+	@param query		=> characters and mask of bases other than ACGT of the current query
+	@param counts		=> mismatch counts of the block produced by the kernel, corrected in place
+	@param masks		=> folded mismatch masks of the block produced by the kernel, corrected in place
+ */
+void OffTarget::countAmbiguous(const PackedSequences &refSeqs, const unsigned long *blockIndexes, int blockCount, const QueryData &query, uint8_t *counts, uint64_t *masks)
+{
+	/* vars */
+	const int seqLength = endoData[4];
+	const int wordsPerSeq = PackedSequences::wordsFor(seqLength);
+	const Column<uint64_t> &ambiguousIndexes = refSeqs.getAmbiguousIndexes();
+	unsigned long a = refSeqs.findAmbiguous(blockIndexes[0]);
+
+	for (int b = 0; b < blockCount; b++)
 	{
-		for (int j = seqLength - 1; j >= 0; j--)
+		/* the recorded targets are walked along with the block, jumping ahead by search past gaps */
+		unsigned long i = blockIndexes[b];
+		if (a < ambiguousIndexes.size() && ambiguousIndexes[a] < i)
+		{
+			a = refSeqs.findAmbiguous(i);
+		}
+		bool recorded = a < ambiguousIndexes.size() && ambiguousIndexes[a] == i;
+		if (!recorded && !query.ambiguous)
+		{
+			continue;
+		}
+
+		uint64_t *mask = &masks[b * wordsPerSeq];
+		if (recorded)
 		{
-			if (refSeq.at(j) != currentQuerySeq.at(j))
+			const char *refChars = refSeqs.getAmbiguousSeqs().data() + a * seqLength;
+			for (int j = 0; j < seqLength; j++)
 			{
-				//store mismatch location
-				mismatchLocations.push_back(j + 1);
-				//store key for HSU matrix
-				hsuKey = string() + refSeq.at(j) + reverseComp(currentQuerySeq.at(j));
-				mismatchKeys.push_back(hsuKey);
+				if (!PackedSequences::isBase(refChars[j]) || !PackedSequences::isBase(query.seq[j]))
+				{
+					int r = seqLength - 1 - j;
+					uint64_t bit = 1ULL << (2 * (r % 32));
+					mask[r / 32] = refChars[j] != query.seq[j] ? mask[r / 32] | bit : mask[r / 32] & ~bit;
+				}
 			}
 		}
-		/* if there are too many mismatches, break */
-		if (mismatchLocations.size() > maxMismatches)
+		else
 		{
-			return false;
+			for (int w = 0; w < wordsPerSeq; w++)
+			{
+				mask[w] |= query.ambiguousMask[w];
+			}
 		}
+
+		int count = 0;
+		for (int w = 0; w < wordsPerSeq; w++)
+		{
+			count += popCount64(mask[w]);
+		}
+		counts[b] = (uint8_t)count;
 	}
+}
 
-	return true;
+/*
+	function to fill in the packed sequence, the characters and the mask of bases other than ACGT of a query
+
+	@param seq		=> seqLength characters of the query
+	@param query	=> query data that gets filled in
+ */
+void OffTarget::setQuerySeq(const string &seq, QueryData &query)
+{
+	/* vars */
+	const int seqLength = endoData[4];
+	const int wordsPerSeq = PackedSequences::wordsFor(seqLength);
+
+	query.packedSeq.resize(wordsPerSeq);
+	PackedSequences::pack(seq, seqLength, query.packedSeq.data());
+	query.seq = seq;
+	query.seq.resize(seqLength, 'A');
+	query.ambiguousMask.assign(wordsPerSeq, 0);
+	query.ambiguous = false;
+	for (int j = 0; j < seqLength; j++)
+	{
+		if (!PackedSequences::isBase(query.seq[j]))
+		{
+			int r = seqLength - 1 - j;
+			query.ambiguousMask[r / 32] |= 1ULL << (2 * (r % 32));
+			query.ambiguous = true;
+		}
+	}
 }
 
 /*
-	function to reverse complement a character
-	
-	@param c => character to perfrom reverse complement on 
-	
-	@return reverse complement of input character
+	function for extracting the mismatch locations and HSU keys of a target compared by the kernel
+
+	Walking the set bits of the folded masks visits the mismatched bases from the 3' end to the 5' end.
+
+	@param mismatchMasks		=> folded mismatch masks of the target produced by the kernel
+	@param refSeq				=> packed sequence pulled from organism CSPR/DB file
+	@param currentQuerySeq		=> packed sequence pulled from query file
+	@param mismatchLocations	=> buffer of MAX_MISMATCH_POSITIONS that gets filled in with the locations the mismatched characters appear at between the two sequences
+	@param mismatchKeys			=> buffer of MAX_MISMATCH_POSITIONS that gets filled in with the HSU table keys to use with each mismatch location
+
+	@return count				=> number of mismatches
  */
-char OffTarget::reverseComp(char &c)
-{
-	char n = 'N';
-	switch (c)
-	{
-	case 'A':
-		n = 'T';
-		break;
-	case 'T':
-		n = 'A';
-		break;
-	case 'G':
-		n = 'C';
-		break;
-	case 'C':
-		n = 'G';
-		break;
-	}
-	return n;
-}
\ No newline at end of file
+template <int SEQ_LENGTH, bool THREE_PRIME>
+int OffTarget::getMismatches(const uint64_t *mismatchMasks, const uint64_t *refSeq, const uint64_t *currentQuerySeq, int *mismatchLocations, uint8_t *mismatchKeys)
+{
+	/* vars */
+	const int seqLength = SEQ_LENGTH > 0 ? SEQ_LENGTH : endoData[4];
+	const int wordsPerSeq = PackedSequences::wordsFor(seqLength);
+	int count = 0;
+
+	for (int w = 0; w < wordsPerSeq; w++)
+	{
+		uint64_t mask = mismatchMasks[w];
+		while (mask)
+		{
+			int shift = trailingZeros64(mask);
+			int r = w * 32 + shift / 2;
+
+			//store mismatch location, base seqLength - 1 - r counted from the 3' or the 5' end
+			mismatchLocations[count] = THREE_PRIME ? r + 1 : seqLength - r;
+
+			//store key for HSU matrix
+			mismatchKeys[count++] = (uint8_t)HsuMatrix::getKey((refSeq[w] >> shift) & 3, 3 - ((currentQuerySeq[w] >> shift) & 3));
+			mask &= mask - 1;
+		}
+	}
+	return count;
+}
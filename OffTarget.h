@@ -1,77 +1,175 @@
 #pragma once
 #include "FileOperations.h"
 #include "Score.h"
+#include "MismatchKernel.h"
+#include "SeedIndex.h"
+#include "FmIndex.h"
+#include "QGramFilter.h"
+#include "HitArena.h"
+#include "ThreadPool.h"
+#include "OrderedWriter.h"
+#include "ReferenceIndex.h"
+#include "SharedReference.h"
+#include "Metrics.h"
 #include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#ifndef _WIN32
+#include <unistd.h>
+#include <cerrno>
+#include <sys/wait.h>
+#endif
+#include <cmath>
 
 using namespace std;
 
+/* stores smaller than this many targets per range task are not split further */
+const unsigned long MIN_TARGETS_PER_TASK = 1UL << 16;
+
+/* most mismatches a target can have, the kernels compare sequences of up to 32 * KERNEL_MAX_WORDS bases */
+const int MAX_MISMATCH_POSITIONS = 32 * KERNEL_MAX_WORDS;
+
 /* OffTarget class represents the primary object of the algorithms implementation */
 class OffTarget
 {
+	/* the benchmarks time the scan stages directly */
+	friend class Benchmark;
+
 	public:
 		/* function for parsing input arguments */
 		void parseInputArguments(int argc, char *argv[]);
+
+		/* function for parsing the input arguments of index mode */
+		void parseIndexArguments(int argc, char *argv[]);
+
+		/* function for writing the reference index of a CSPR file and its repeats DB */
+		void buildIndex();
 		
 		/* parse data needed for algorithm */
 		void getAlgorithmData();
 		
 		/* function for running the OffTarget algorithm */
 		void run();
+
+		/* function for running the OffTarget algorithm split across shard worker processes */
+		void runShards();
+
+		/* returns the number of shard worker processes given by --shards, 0 or 1 runs in this process */
+		int getShardCount() const { return shardCount; }
+
+		/* function for parsing the organism arguments of server mode */
+		bool parseOrganismArguments(vector<string> &fields);
+
+		/* function for loading CASPERinfo and the reference targets, everything getAlgorithmData does but the queries */
+		void loadReference();
+
+		/*
+			QueryBatch holds the queries of one run and how their results are reported
+			querySeqs		=> concatenated query sequences, getSeqLength() bases each
+			queryScores		=> on-target score of each query sequence
+			threshold		=> scores below this threshold are not reported, 0 reports every hit
+			topK			=> only the topK best scoring hits of each query are written in detailed output, 0 writes all
+			avgOutput		=> only the average score of each query is written
+			shardOutput		=> hits are encoded for a shard coordinator instead of formatted as output lines
+		*/
+		struct QueryBatch
+		{
+			string querySeqs;
+			vector<uint8_t> queryScores;
+			double threshold = 0;
+			unsigned long topK = 0;
+			bool avgOutput = false;
+			bool shardOutput = false;
+		};
+
+		/* function for scoring a batch of queries against the loaded reference and streaming the results */
+		void runBatch(const QueryBatch &queryBatch, const function<void(const string &)> &output);
+
+		/* returns the length of the target and query sequences of the loaded endo */
+		int getSeqLength() const { return endoData[4]; }
 	
 	private:
 		/*	
 			Input argument variable definitions:
 			queryFile		=> File path to input file holding sequence data to run against the reference organism data and get off target score for
 			endo			=> Defines endonuclease used 
-			csprFile		=> File path to GZIP cspr file of organism
+			csprFile		=> File path to cspr file of organism, plain text or GZIP/BGZF compressed
 			sqlFile			=> File path for SQL repeats file of organism
 			outputFile		=> File path for output file
 			casperInfoFile	=> File path to CASPERinfo
 			maxMismatches	=> Defines the number of max mismatched letters between two sequences
-			threshold		=> Defines the threshold value for scores: score below this threshold will not be reported
+			threshold		=> Defines the threshold value for scores: score below this threshold will not be reported, 0 reports every hit
 			avgOutput		=> Defines if average output format is used: only the offtarget score is shown for each query sequences in the output file
 			detailedOutput	=> Defines if detailed output format is used: provides additional information on targets found from the algorithm
 			hsuMatrixName	=> HSU matrix name to parse from CASPERinfo
 			three_prime		=> boolean - True = 3 prime, False = 5 prime
+
+			Optional arguments, given as --name=value after the required arguments:
+			engine			=> --engine=auto|scan|seed|fm, search engine used to find targets within maxMismatches of each query
+			threadCount		=> --threads=N, number of worker threads in the pool running the query tasks, defaults to the number of hardware threads
+			topK			=> --top-k=N, only the N best scoring hits of each query are written in detailed output, 0 writes all of them
+			tileTargets		=> --tile-targets=N, reference targets per cache tile, 0 sizes tiles to half the L2 cache
+			tileQueries		=> --tile-queries=N, queries compared against each tile before moving on, 0 picks a batch size from the query and thread counts
+			indexFilePath	=> --index=path, reference index (.otidx) loaded instead of parsing the CSPR and DB files, see OT index
+			useSharedMemory	=> --shared-memory, share one copy of the reference between the OT processes loading the same files
+			useQGramFilter	=> --qgram-filter, reject scanned targets by their 3-gram signatures before comparing them
+			shardCount		=> --shards=N, split the reference across N worker processes and merge their hits in this one
+			metricsFilePath	=> --metrics=path, write the time spent in each phase and the scan counters of the run as JSON
+
+			Index mode arguments, OT index endo csprFile sqlFile casperInfoFile indexFile:
+			indexFilePath	=> File path of the reference index written from the CSPR and DB files
 		*/
 		bool avgOutput = false, detailedOutput = false;
 		int maxMismatches = 0;
 		double threshold = 0;
 		string endo, queryFilePath, csprFilePath, sqlFilePath, outputFilePath, casperInfoFilePath, hsuMatrixName;
 		bool three_prime = true;
+		string engine = "auto";
+		int threadCount = max(1, (int)thread::hardware_concurrency());
+		unsigned long topK = 0;
+		unsigned long tileTargets = 0, tileQueries = 0;
+		string indexFilePath;
+		bool useSharedMemory = false;
+		bool useQGramFilter = false;
+		int shardCount = 0;
+		string metricsFilePath;
+
+		/* shard of the reference kept by a shard worker, -1 outside of one */
+		int shardIndex = -1;
+
+		/* rowid ranges of the repeats DB with their seed groups, counted before the shard workers are started */
+		RepeatRowidRanges repeatRowidRanges;
 
 		/* 
 			CASPERinfo variable definitions
 			endoData	=> vector containing {pam length, 3' length, seed length, 5' length, sequence length}
-			hsuMatrix	=> See CASPERinfo for HSU matrix structure
+			hsuMatrix	=> See CASPERinfo for HSU matrix structure, compiled into a table indexed by base codes
 		*/
 		vector<int> endoData;
-		map<string, vector<double>> hsuMatrix;
-		vector<string> hsuKeys = { "GT", "AC", "GG", "TG", "TT", "CA", "CT", "GA", "AA", "AG", "TC", "CC" };
+		HsuMatrix hsuMatrix;
 
 		/*
 			CSPR file variable definitions
-			uniqueSeqs		=> concatenated string of all unqiue sequences in CSPR file
+			uniqueSeqs		=> 2-bit packed store of all unqiue sequences in CSPR file
 			uniqueScores	=> vector of ints holding the scores of each unqiue sequence
-			uniqueLocations	=> vector holding the locations of sequences from CSPR file
-			uniqueChroms	=> vector holding the chromosome of each sequence from CSPR file
+			uniqueLocations	=> chromosome and location of each sequence from CSPR file, chromosomes kept as runs
 		*/
-		string uniqueSeqs;
-		vector<uint8_t> uniqueScores;
-		vector<long long> uniqueLocations;
-		vector<int> uniqueChroms;
+		PackedSequences uniqueSeqs;
+		Column<uint8_t> uniqueScores;
+		LocationColumn uniqueLocations;
 
 		/*
 			DB file variable definitions
-			repeatSeqs		=> concatendated string of all repeat sequences in the db file
+			repeatSeqs		=> 2-bit packed store of all repeat sequences in the db file
 			repeatScores	=> vector of ints holding the scores of each repeat sequence
-			repeatLocations	=> vector holding the locations of the repeat sequences in the db file
-			repeatChroms	=> vector holding the chromosome of each sequence in db file
+			repeatLocations	=> chromosome and location of each repeat sequence in the db file
+			repeatGroups	=> groups of consecutive repeat sequences sharing the seed of a db row
 		*/
-		string repeatSeqs;
-		vector<uint8_t> repeatScores;
-		vector<long long> repeatLocations;
-		vector<int> repeatChroms;
+		PackedSequences repeatSeqs;
+		Column<uint8_t> repeatScores;
+		LocationColumn repeatLocations;
+		Column<RepeatGroup> repeatGroups;
 
 		/*
 			Query file variable definitions
@@ -81,29 +179,213 @@ class OffTarget
 		string querySeqs;
 		vector<uint8_t> queryScores;
 
+		/* reference index mapped by --index, holds the memory the reference stores view when it is used */
+		ReferenceIndex referenceIndex;
+
+		/*
+			Shared memory variable definitions, used with --shared-memory
+			sharedReference	=> segment holding the reference image shared by the OT processes loading the same files
+			sharedIndex		=> index over the image in the segment, the reference stores view it once it is attached
+		*/
+		SharedReference sharedReference;
+		ReferenceIndex sharedIndex;
+
+		/* phase timers and scan counters of the run, written to metricsFilePath */
+		Metrics metrics;
+
 		/* FileOperations object - used for all file parsing/writing operations */
 		FileOperations FileOp;
 
 		/* score object to run scoring algorithms */
 		Score score;
 
+		/* kernel used to compare blocks of reference targets against a query, selected for the running CPU */
+		MismatchKernel kernel;
+
+		/*
+			Seed index variable definitions
+			useSeedIndex	=> true if candidates come from the seed indexes instead of scanning every target
+			uniqueIndex		=> seed index over the unique sequences
+			repeatIndex		=> seed index over the repeat sequences
+			useFmIndex		=> true if candidates come from the FM indexes instead of scanning every target
+			uniqueFmIndex	=> FM index over the unique sequences
+			repeatFmIndex	=> FM index over the repeat sequences
+		*/
+		bool useSeedIndex = false;
+		SeedIndex uniqueIndex;
+		SeedIndex repeatIndex;
+		bool useFmIndex = false;
+		FmIndex uniqueFmIndex;
+		FmIndex repeatFmIndex;
+
+		/*
+			Q-gram filter variable definitions, built with --qgram-filter when the scan engine is used
+			uniqueFilter	=> 3-gram signatures of the unique sequences
+			repeatFilter	=> 3-gram signatures of the repeat sequences
+		*/
+		QGramFilter uniqueFilter;
+		QGramFilter repeatFilter;
+
 		/* vector to hold OffTarget scores for query sequences */
 		vector<double> queryOffTargetScores;
 
-		/* 	OffTarget analysis function for finding similar sequences in the reference organism, scoring the findings, and writing out the results 
-			findSimilars is a wrapper for calling findSimilarsUnique and findSimiarsRepeat for each query sequence
+		/*
+			RankedHit is a hit held for ranking in top-K mode
+			hit			=> the hit
+			position	=> order the hit was found in, so the hits kept can be put back in that order
 		*/
-		void findSimilars(string currentQuerySeq, int currentQueryScore, vector<vector<double> > &targetScores, vector<vector<unsigned long> > &targetIndexes);
+		struct RankedHit
+		{
+			HitRecord hit;
+			unsigned long position;
+		};
+
+		/*
+			HitBuffer holds the hits found by a range task, or the counts of every task of a query's source once they are merged
+			hits			=> hits kept, in reference order
+			topHits			=> in top-K mode the best hits of the task so far, a heap with the worst ranked hit in front
+			arena			=> arena of the worker running the task, the hits list grows from it
+			source			=> 0 for a task over the unique store, 1 for the repeat store
+			scoreSum		=> sum of the scores of every hit found, including hits dropped in top-K mode
+			hitCount		=> number of hits found, including hits dropped in top-K mode
+			examined		=> targets compared against the query
+			skipped			=> repeat targets skipped with their seed group
+			filtered		=> targets rejected by the q-gram filter before being compared
+			candidates		=> targets within maxMismatches, exact matches excluded where they are skipped
+			scored			=> candidates whose mismatches were extracted and scored
+			pruned			=> candidates dropped below the threshold, by their score bound or their score
+		*/
+		struct HitBuffer
+		{
+			HitList hits;
+			vector<RankedHit> topHits;
+			HitArena *arena = nullptr;
+			int source = 0;
+			double scoreSum = 0.0;
+			unsigned long hitCount = 0;
+			unsigned long examined = 0, skipped = 0, filtered = 0, candidates = 0, scored = 0, pruned = 0;
+		};
+
+		/*
+			QueryData holds what the scans need of a query sequence
+			packedSeq	=> 2-bit packed query sequence
+			seq			=> characters of the query sequence
+			ambiguousMask	=> folded mask of the query's bases other than ACGT, all zero for most queries
+			ambiguous	=> true if the query holds a base other than ACGT
+			qgramSignature	=> 3-gram signature of the query, compared with the targets' by the q-gram filter
+			ratioTerms	=> (reference score / query score)^2 for every possible uint8_t reference score
+			threshold	=> threshold of the query's batch
+			topK		=> top-K setting of the query's batch
+		*/
+		struct QueryData
+		{
+			vector<uint64_t> packedSeq;
+			string seq;
+			vector<uint64_t> ambiguousMask;
+			bool ambiguous;
+			uint64_t qgramSignature;
+			double ratioTerms[256];
+			double threshold;
+			unsigned long topK;
+		};
+
+		/*
+			QueryResults holds the hits of a query while its range tasks run
+			hits						=> one buffer per range task, unique ranges first, merged in task order
+			remainingTasks				=> range tasks of the query that have not finished, the task taking it to 0 writes the query
+		*/
+		struct QueryResults
+		{
+			vector<HitBuffer> hits;
+			atomic<unsigned long> remainingTasks;
+		};
+
+		/* scoring kernel specialized for the endo's sequence length and orientation, picked once by selectScoreBlock */
+		typedef void (OffTarget::*ScoreBlockFunction)(const uint64_t *blockSeqs, const unsigned long *blockIndexes, int blockCount, Column<uint8_t> &refScores, bool skipExactMatches, const QueryData &query, HitBuffer &hits);
+		ScoreBlockFunction scoreBlock = nullptr;
+
+		/* function for parsing one optional argument given as --name=value */
+		bool parseOptionalArgument(const string &arg);
+
+		/* function to load the reference stores from the index given by --index */
+		bool loadIndex();
+
+		/* function to point the reference stores at the shared memory copy published by another OT process */
+		bool attachSharedReference();
+
+		/* function to copy the loaded reference stores into the shared memory segment and view them there */
+		void publishSharedReference();
+
+		/* function to keep only this worker's shard of the reference stores */
+		void keepShard();
+
+		/* function to build the FM indexes over the reference stores */
+		void buildFmIndexes();
+
+		/* function run by a forked shard worker: loads its shard of the reference and streams the hits of every query */
+		void runShardWorker(int shard, int fd);
+
+		/* function to encode the hits of a query found by a shard worker for the coordinator */
+		string formatShardResults(vector<HitBuffer> &merged, HitList &hits, bool avgOutput);
+
+		/* function to read the hits of a query sent by a shard worker and append them to the query's merged hits */
+		bool readShardResults(FILE *shard, vector<HitBuffer> &merged, vector<vector<string> > &lines, HitArena &arena);
+
+		/* function to get the size of the per core cache used to size reference tiles */
+		static unsigned long getCacheSize();
+
+		/* function to drop all but the topK best scoring hits of a hit list */
+		void keepTopHits(HitList &hits, unsigned long topK);
+
+		/* function to offer a hit to the bounded heap of the topK best hits of a task */
+		void addTopHit(HitBuffer &hits, const HitRecord &hit, unsigned long topK);
+
+		/* function to move the best hits of a task from its heap to its hit list, in the order they were found */
+		void flushTopHits(HitBuffer &hits);
+
+		/* returns true if hit x ranks before hit y in top-K mode */
+		static bool ranksBefore(const HitRecord &x, const HitRecord &y);
+
+		/* function to get the average score of a query's hits */
+		double getAverageScore(vector<HitBuffer> &merged, HitList &hits, unsigned long topK);
+
+		/* 	OffTarget analysis function for finding similar sequences in the reference organism and scoring the findings
+			findSimilars is a wrapper for calling findSimilarsUnique or findSimiarsRepeat for a range task of a query sequence
+		*/
+		void findSimilars(const QueryData &query, int source, unsigned long first, unsigned long last, HitBuffer &hits);
 
 		/* function for running off target analysis of query sequence against the unique organism data from CSPR file */
-		void findSimilarsUnique(string &currentQuerySeq, int &currentQueryScore, int &seqLength, vector<double> &runningScores, vector<unsigned long> &targetIndexes);
+		void findSimilarsUnique(const QueryData &query, unsigned long first, unsigned long last, HitBuffer &hits);
 
 		/* function for running off target analysis of query sequence against the repeat organism data from DB file */
-		void findSimilarsRepeat(string &currentQuerySeq, int &currentQueryScore, int &seqLength, vector<double> &runningScores, vector<unsigned long> &targetIndexes);
+		void findSimilarsRepeat(const QueryData &query, unsigned long first, unsigned long last, HitBuffer &hits);
+
+		/* function for comparing every target in a range of a reference store against the query */
+		void compareRange(PackedSequences &refSeqs, Column<uint8_t> &refScores, QGramFilter &refFilter, unsigned long first, unsigned long last, bool skipExactMatches, const QueryData &query, HitBuffer &hits);
+
+		/* function for comparing a range of the repeat store against the query a seed group at a time */
+		void compareGroups(unsigned long first, unsigned long last, const QueryData &query, HitBuffer &hits);
+
+		/* function to collect the candidate targets of a range task from the seed or FM index of its reference store */
+		void getCandidates(const QueryData &query, int source, unsigned long first, unsigned long last, vector<unsigned long> &candidates);
+
+		/* function for comparing a sorted list of candidate targets of a reference store against the query */
+		void compareCandidates(PackedSequences &refSeqs, Column<uint8_t> &refScores, vector<unsigned long> &candidates, bool skipExactMatches, const QueryData &query, HitBuffer &hits);
+
+		/* function to pick the scoring kernel specialized for the endo's sequence length and orientation */
+		ScoreBlockFunction selectScoreBlock();
+
+		/* function for comparing a block of packed targets against the query and scoring the ones within maxMismatches */
+		template <int SEQ_LENGTH, bool THREE_PRIME>
+		void scoreBlockFor(const uint64_t *blockSeqs, const unsigned long *blockIndexes, int blockCount, Column<uint8_t> &refScores, bool skipExactMatches, const QueryData &query, HitBuffer &hits);
+
+		/* function to count the mismatches of bases other than ACGT in a block compared by the kernel as a character compare does */
+		void countAmbiguous(const PackedSequences &refSeqs, const unsigned long *blockIndexes, int blockCount, const QueryData &query, uint8_t *counts, uint64_t *masks);
 
-		/* function for character wise comparison of two sequences */
-		bool getMismatches(string &refSeq, string &currentQuerySeq, vector<int> &mismatchLocations, vector<string> &hsuKeys, int &seqLength);
+		/* function to fill in the characters and the mask of bases other than ACGT of a query */
+		void setQuerySeq(const string &seq, QueryData &query);
 
-		/* function to reverse complement a character */
-		char reverseComp(char &c);
+		/* function for extracting the mismatch locations and HSU keys of a target compared by the kernel, returns their number */
+		template <int SEQ_LENGTH, bool THREE_PRIME>
+		int getMismatches(const uint64_t *mismatchMasks, const uint64_t *refSeq, const uint64_t *currentQuerySeq, int *mismatchLocations, uint8_t *hsuKeys);
 };
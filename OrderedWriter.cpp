@@ -0,0 +1,66 @@
+#include "OrderedWriter.h"
+
+/*
+	creates a writer handing blocks to output
+
+	@param output	=> called with each block in query order, never from two threads at once
+	@param capacity	=> number of queries that may be in flight past the last one written, at least one
+ */
+OrderedWriter::OrderedWriter(const function<void(const string &)> &output, unsigned long capacity) : output(output), capacity(max(1UL, capacity))
+{
+	blocks.resize(this->capacity);
+	ready.assign(this->capacity, false);
+}
+
+/*
+	function to block until the query with the given index fits in the reorder buffer
+
+	@param index	=> index of the query about to be started
+ */
+void OrderedWriter::waitForRoom(unsigned long index)
+{
+	unique_lock<mutex> guard(lock);
+	roomAvailable.wait(guard, [this, index]() { return index < nextToWrite + capacity; });
+}
+
+/*
+	function to hand over the formatted block of a query
+
+	@param index	=> index of the query, waitForRoom must have returned for it
+	@param block	=> formatted output lines of the query
+ */
+void OrderedWriter::submit(unsigned long index, string block)
+{
+	vector<string> pending;
+	unique_lock<mutex> guard(lock);
+	blocks[index % capacity] = move(block);
+	ready[index % capacity] = true;
+
+	/* the thread already writing picks the block up once it is done with its own */
+	if (writing)
+	{
+		return;
+	}
+	writing = true;
+	while (ready[nextToWrite % capacity])
+	{
+		/* take every consecutive ready block and free their slots before writing them outside the lock */
+		while (ready[nextToWrite % capacity])
+		{
+			pending.push_back(move(blocks[nextToWrite % capacity]));
+			blocks[nextToWrite % capacity].clear();
+			ready[nextToWrite % capacity] = false;
+			nextToWrite++;
+		}
+		roomAvailable.notify_all();
+
+		guard.unlock();
+		for (unsigned long i = 0; i < pending.size(); i++)
+		{
+			output(pending[i]);
+		}
+		pending.clear();
+		guard.lock();
+	}
+	writing = false;
+}
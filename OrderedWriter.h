@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+using namespace std;
+
+/*
+	OrderedWriter streams formatted query blocks to an output in query order
+
+	Blocks are submitted by whichever worker finishes a query and wait in a reorder buffer of capacity slots until every
+	earlier query has been written. The worker that submits the next block in order writes out every consecutive ready
+	block outside the lock while later submitters keep computing, and the producer blocks in waitForRoom before
+	starting a query that would not fit in the buffer, so memory is bounded by capacity queries.
+*/
+class OrderedWriter
+{
+	public:
+		/* creates a writer handing blocks to output with room for capacity queries in flight */
+		OrderedWriter(const function<void(const string &)> &output, unsigned long capacity);
+
+		/* function to block until the query with the given index fits in the reorder buffer */
+		void waitForRoom(unsigned long index);
+
+		/* function to hand over the formatted block of a query, writing it and any following ready blocks when it is next */
+		void submit(unsigned long index, string block);
+
+	private:
+		/*
+			blocks		=> reorder buffer, query i waits in slot i % capacity
+			ready		=> true for the slots holding a submitted block
+			nextToWrite	=> index of the next query to write
+			writing		=> true while a thread is writing blocks outside the lock
+		*/
+		function<void(const string &)> output;
+		unsigned long capacity;
+		vector<string> blocks;
+		vector<bool> ready;
+		unsigned long nextToWrite = 0;
+		bool writing = false;
+		mutex lock;
+		condition_variable roomAvailable;
+};
@@ -0,0 +1,336 @@
+#include "PackedSequences.h"
+#include <algorithm>
+
+/* 2-bit codes for each base character, anything other than ACGT is packed as A and recorded by addAmbiguous */
+static inline uint64_t baseCode(char c)
+{
+	switch (c)
+	{
+	case 'C':
+		return 1;
+	case 'G':
+		return 2;
+	case 'T':
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+/*
+	function to set the sequence length and clear any stored sequences
+
+	@param length	=> length of every sequence that will be stored
+ */
+void PackedSequences::init(int length)
+{
+	seqLength = length;
+	wordsPerSeq = wordsFor(length);
+	count = 0;
+	words.clear();
+	seqWords = words.data();
+	ambiguousIndexes = Column<uint64_t>();
+	ambiguousSeqs = Column<char>();
+}
+
+/*
+	function to reserve space for a number of sequences
+
+	@param n	=> number of sequences to reserve space for
+ */
+void PackedSequences::reserve(unsigned long n)
+{
+	words.reserve(n * wordsPerSeq);
+	seqWords = words.data();
+}
+
+/*
+	function to append a sequence to the store
+
+	@param seq	=> sequence to pack, only the first seqLength characters are stored
+ */
+void PackedSequences::append(const string &seq)
+{
+	words.resize(words.size() + wordsPerSeq, 0);
+	pack(seq, seqLength, &words[count * wordsPerSeq]);
+	seqWords = words.data();
+	if (isAmbiguous(seq.data(), (int)seq.length(), seqLength))
+	{
+		addAmbiguous(count, seq.data(), (int)seq.length());
+	}
+	count++;
+}
+
+/*
+	function to append a sequence given as a character range to the store
+
+	@param seq		=> characters of the sequence
+	@param length	=> number of characters, only the first seqLength are stored
+ */
+void PackedSequences::appendChars(const char *seq, int length)
+{
+	words.resize(words.size() + wordsPerSeq, 0);
+	pack(seq, length, seqLength, &words[count * wordsPerSeq]);
+	seqWords = words.data();
+	if (isAmbiguous(seq, length, seqLength))
+	{
+		addAmbiguous(count, seq, length);
+	}
+	count++;
+}
+
+/*
+	function to append every sequence of another store
+
+	@param other	=> store holding sequences of the same length
+ */
+void PackedSequences::append(const PackedSequences &other)
+{
+	words.insert(words.end(), other.data(), other.data() + other.size() * wordsPerSeq);
+	seqWords = words.data();
+	for (unsigned long a = 0; a < other.ambiguousIndexes.size(); a++)
+	{
+		ambiguousIndexes.push_back(count + other.ambiguousIndexes[a]);
+	}
+	ambiguousSeqs.append(other.ambiguousSeqs);
+	count += other.size();
+}
+
+/*
+	function to resize the store, new sequences are all A
+
+	@param n	=> number of sequences the store holds afterwards
+ */
+void PackedSequences::resize(unsigned long n)
+{
+	words.resize(n * wordsPerSeq, 0);
+	seqWords = words.data();
+	count = n;
+}
+
+/*
+	function to overwrite a stored sequence, a sequence holding bases other than ACGT (isAmbiguous) must also be
+	recorded with addAmbiguous, which the caller does in index order once the threads setting sequences are done
+
+	@param index	=> index of the sequence in the store
+	@param seq		=> characters of the sequence
+	@param length	=> number of characters, only the first seqLength are stored
+ */
+void PackedSequences::set(unsigned long index, const char *seq, int length)
+{
+	pack(seq, length, seqLength, &words[index * wordsPerSeq]);
+}
+
+/*
+	function to count the mismatched bases of a span of two packed sequences
+
+	@param ref			=> packed words of the first sequence
+	@param query		=> packed words of the second sequence
+	@param seqLength	=> length of both sequences
+	@param start		=> first base of the span
+	@param length		=> number of bases in the span, clipped to the sequence
+
+	@return mismatches	=> number of bases of the span that differ
+ */
+int PackedSequences::spanMismatches(const uint64_t *ref, const uint64_t *query, int seqLength, int start, int length)
+{
+	/* bases [start, start + length) are stored at reversed indexes [seqLength - start - length, seqLength - start) */
+	int low = max(0, seqLength - start - length);
+	int high = max(0, seqLength - start);
+	int mismatches = 0;
+	for (int w = low / 32; w * 32 < high; w++)
+	{
+		int first = max(low, w * 32) - w * 32;
+		int last = min(high, w * 32 + 32) - w * 32;
+		uint64_t span = last - first == 32 ? ~0ULL : ((1ULL << (2 * (last - first))) - 1) << (2 * first);
+		mismatches += popCount64(mismatchMask(ref[w], query[w]) & span);
+	}
+	return mismatches;
+}
+
+/*
+	function to view packed sequences in memory owned elsewhere, the memory must outlive the store
+
+	@param length	=> length of every sequence in the memory
+	@param n		=> number of sequences in the memory
+	@param data		=> n * wordsFor(length) packed words
+ */
+void PackedSequences::attach(int length, unsigned long n, const uint64_t *data)
+{
+	seqLength = length;
+	wordsPerSeq = wordsFor(length);
+	count = n;
+	vector<uint64_t>().swap(words);
+	seqWords = data;
+	ambiguousIndexes = Column<uint64_t>();
+	ambiguousSeqs = Column<char>();
+}
+
+/*
+	function to record the characters of a stored sequence holding bases other than ACGT, called in ascending index
+	order
+
+	@param index	=> index of the sequence in the store
+	@param seq		=> characters of the sequence
+	@param length	=> number of characters, shorter sequences are padded with A as they are packed
+ */
+void PackedSequences::addAmbiguous(unsigned long index, const char *seq, int length)
+{
+	ambiguousIndexes.push_back(index);
+	for (int j = 0; j < seqLength; j++)
+	{
+		ambiguousSeqs.push_back(j < length ? seq[j] : 'A');
+	}
+}
+
+/*
+	function to view the recorded sequences holding bases other than ACGT in memory owned elsewhere, the memory must
+	outlive the store
+
+	@param indexData	=> n ascending sequence indexes
+	@param seqData		=> n * seqLength characters
+	@param n			=> number of recorded sequences
+ */
+void PackedSequences::attachAmbiguous(const uint64_t *indexData, const char *seqData, unsigned long n)
+{
+	ambiguousIndexes.attach(indexData, n);
+	ambiguousSeqs.attach(seqData, n * seqLength);
+}
+
+/*
+	function to find the first recorded sequence holding bases other than ACGT at or after a store index
+
+	@param index	=> index of the sequence in the store
+
+	@return position	=> position in getAmbiguousIndexes, its size if there is none
+ */
+unsigned long PackedSequences::findAmbiguous(unsigned long index) const
+{
+	const uint64_t *begin = ambiguousIndexes.data(), *end = begin + ambiguousIndexes.size();
+	return lower_bound(begin, end, (uint64_t)index) - begin;
+}
+
+/*
+	function to get the characters of a stored sequence holding bases other than ACGT
+
+	@param index	=> index of the sequence in the store
+
+	@return seq	=> seqLength characters, null if every base of the sequence is ACGT
+ */
+const char *PackedSequences::getAmbiguousBases(unsigned long index) const
+{
+	unsigned long a = findAmbiguous(index);
+	return a < ambiguousIndexes.size() && ambiguousIndexes[a] == index ? ambiguousSeqs.data() + a * seqLength : nullptr;
+}
+
+/*
+	function to keep only a range of the stored sequences
+
+	@param first	=> index of the first sequence kept
+	@param last		=> index one past the last sequence kept
+ */
+void PackedSequences::slice(unsigned long first, unsigned long last)
+{
+	if (!words.empty())
+	{
+		vector<uint64_t>(words.begin() + first * wordsPerSeq, words.begin() + last * wordsPerSeq).swap(words);
+		seqWords = words.data();
+	}
+	else
+	{
+		seqWords += first * wordsPerSeq;
+	}
+	count = last - first;
+
+	/* the recorded sequences of the range are kept, rebased onto first */
+	unsigned long ambiguousFirst = findAmbiguous(first), ambiguousLast = findAmbiguous(last);
+	vector<uint64_t> indexes(ambiguousIndexes.data() + ambiguousFirst, ambiguousIndexes.data() + ambiguousLast);
+	for (unsigned long a = 0; a < indexes.size(); a++)
+	{
+		indexes[a] -= first;
+	}
+	ambiguousIndexes = Column<uint64_t>();
+	ambiguousIndexes.assign(indexes);
+	ambiguousSeqs.slice(ambiguousFirst * seqLength, ambiguousLast * seqLength);
+}
+
+/*
+	function to decode a stored sequence back into a string
+
+	@param index	=> index of the sequence in the store
+
+	@return seq	=> decoded sequence, with its characters as they were stored if it holds bases other than ACGT
+ */
+string PackedSequences::unpack(unsigned long index) const
+{
+	static const char bases[4] = { 'A', 'C', 'G', 'T' };
+	const uint64_t *seqWords = getSequence(index);
+	const char *ambiguousSeq = getAmbiguousBases(index);
+	if (ambiguousSeq != nullptr)
+	{
+		return string(ambiguousSeq, seqLength);
+	}
+	string seq(seqLength, 'A');
+	for (int j = 0; j < seqLength; j++)
+	{
+		int r = seqLength - 1 - j;
+		seq[j] = bases[(seqWords[r / 32] >> (2 * (r % 32))) & 3];
+	}
+	return seq;
+}
+
+/*
+	function to pack a single sequence into the given words
+
+	@param seq			=> sequence to pack
+	@param seqLength	=> number of bases to pack
+	@param words		=> wordsFor(seqLength) words that get filled with the packed sequence
+ */
+void PackedSequences::pack(const string &seq, int seqLength, uint64_t *words)
+{
+	pack(seq.data(), (int)seq.length(), seqLength, words);
+}
+
+/*
+	function to pack a sequence given as a character range into the given words
+
+	@param seq			=> characters of the sequence
+	@param length		=> number of characters, shorter sequences leave the remaining bases as A
+	@param seqLength	=> number of bases to pack
+	@param words		=> wordsFor(seqLength) words that get filled with the packed sequence
+ */
+void PackedSequences::pack(const char *seq, int length, int seqLength, uint64_t *words)
+{
+	length = seqLength < length ? seqLength : length;
+	for (int w = 0; w < wordsFor(seqLength); w++)
+	{
+		words[w] = 0;
+	}
+	for (int j = 0; j < length; j++)
+	{
+		int r = seqLength - 1 - j;
+		words[r / 32] |= baseCode(seq[j]) << (2 * (r % 32));
+	}
+}
+
+/*
+	function to check a sequence for bases other than ACGT
+
+	@param seq			=> characters of the sequence
+	@param length		=> number of characters
+	@param seqLength	=> number of bases packed
+
+	@return true	=> one of the packed bases isn't ACGT and gets packed as A
+ */
+bool PackedSequences::isAmbiguous(const char *seq, int length, int seqLength)
+{
+	length = seqLength < length ? seqLength : length;
+	for (int j = 0; j < length; j++)
+	{
+		if (!isBase(seq[j]))
+		{
+			return true;
+		}
+	}
+	return false;
+}
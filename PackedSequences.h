@@ -0,0 +1,163 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Column.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+/*
+	RepeatGroup describes consecutive repeat targets that share a seed at the same bases
+	first		=> store index of the group's first target, the group ends where the next one starts
+	seedStart	=> first base of the shared seed
+	seedLength	=> number of bases of the shared seed
+*/
+struct RepeatGroup
+{
+	uint64_t first;
+	uint8_t seedStart;
+	uint8_t seedLength;
+};
+
+/*
+	PackedSequences stores fixed length sequences at 2 bits per base (A=0, C=1, G=2, T=3)
+
+	Each sequence occupies wordsPerSeq 64-bit words. Base j of a sequence is stored at reversed index r = seqLength - 1 - j,
+	in word r / 32 at bit 2 * (r % 32), so walking the set bits of a mismatch mask from the lowest bit up visits the bases
+	from the 3' end of the sequence towards the 5' end. Unused high bits of the last word are always zero.
+
+	Bases other than ACGT, such as N, are packed as A. The store keeps the characters of every sequence holding one,
+	sparse since they are rare, so the mismatches of those bases can be counted as a character compare counts them and
+	the sequence decodes back to its characters.
+
+	The words are either owned, appended while parsing, or viewed in place in memory owned elsewhere such as a memory
+	mapped reference index.
+*/
+class PackedSequences
+{
+	public:
+		/* function to set the sequence length and clear any stored sequences */
+		void init(int seqLength);
+
+		/* function to reserve space for a number of sequences */
+		void reserve(unsigned long count);
+
+		/* function to append a sequence to the store */
+		void append(const string &seq);
+
+		/* function to append a sequence given as a character range to the store */
+		void appendChars(const char *seq, int length);
+
+		/* function to append every sequence of another store of the same length */
+		void append(const PackedSequences &other);
+
+		/* function to resize the store to count sequences, new sequences are all A */
+		void resize(unsigned long count);
+
+		/* function to overwrite a stored sequence, safe from several threads for distinct indexes, see addAmbiguous */
+		void set(unsigned long index, const char *seq, int length);
+
+		/* function to view count packed sequences in memory owned elsewhere, dropping any owned sequences */
+		void attach(int seqLength, unsigned long count, const uint64_t *words);
+
+		/* function to record the characters of a sequence holding bases other than ACGT, in ascending index order */
+		void addAmbiguous(unsigned long index, const char *seq, int length);
+
+		/* function to view the recorded sequences holding bases other than ACGT in memory owned elsewhere */
+		void attachAmbiguous(const uint64_t *indexData, const char *seqData, unsigned long n);
+
+		/* returns the position of the first recorded sequence at or after index, see getAmbiguousIndexes */
+		unsigned long findAmbiguous(unsigned long index) const;
+
+		/* returns the characters of the sequence at index if it holds bases other than ACGT, null otherwise */
+		const char *getAmbiguousBases(unsigned long index) const;
+
+		/* returns the recorded sequences holding bases other than ACGT, written as sections of a reference index */
+		const Column<uint64_t> &getAmbiguousIndexes() const { return ambiguousIndexes; }
+		const Column<char> &getAmbiguousSeqs() const { return ambiguousSeqs; }
+
+		/* function to keep only the sequences in [first, last), owned sequences outside the range are freed */
+		void slice(unsigned long first, unsigned long last);
+
+		/* function to decode a stored sequence back into a string */
+		string unpack(unsigned long index) const;
+
+		/* function to pack a single sequence into the given words */
+		static void pack(const string &seq, int seqLength, uint64_t *words);
+
+		/* function to pack length characters into the given words */
+		static void pack(const char *seq, int length, int seqLength, uint64_t *words);
+
+		/* returns true if the first seqLength of length characters hold a base other than ACGT */
+		static bool isAmbiguous(const char *seq, int length, int seqLength);
+
+		/* returns true if a character is one of the bases ACGT */
+		static bool isBase(char c) { return c == 'A' || c == 'C' || c == 'G' || c == 'T'; }
+
+		/* returns the length of the stored sequences */
+		int getSeqLength() const { return seqLength; }
+
+		/* returns the number of sequences stored */
+		unsigned long size() const { return count; }
+
+		/* returns the number of 64-bit words used per sequence */
+		int getWordsPerSeq() const { return wordsPerSeq; }
+
+		/* returns the packed words of the sequence at index */
+		const uint64_t *getSequence(unsigned long index) const { return seqWords + index * wordsPerSeq; }
+
+		/* returns the packed words of every sequence, size() * getWordsPerSeq() words */
+		const uint64_t *data() const { return seqWords; }
+
+		/* function to count the mismatched bases of a span of two packed sequences */
+		static int spanMismatches(const uint64_t *ref, const uint64_t *query, int seqLength, int start, int length);
+
+		/* returns the number of 64-bit words needed to pack a sequence of seqLength bases */
+		static int wordsFor(int seqLength) { return (seqLength + 31) / 32; }
+
+	private:
+		int seqLength = 0;
+		int wordsPerSeq = 0;
+		unsigned long count = 0;
+		vector<uint64_t> words;
+		const uint64_t *seqWords = nullptr;
+
+		/*
+			ambiguousIndexes	=> ascending indexes of the sequences holding bases other than ACGT
+			ambiguousSeqs		=> seqLength characters of each of them
+		*/
+		Column<uint64_t> ambiguousIndexes;
+		Column<char> ambiguousSeqs;
+};
+
+/* collapse the XOR of two packed words into a mask holding the low bit of each mismatched base */
+inline uint64_t mismatchMask(uint64_t ref, uint64_t query)
+{
+	uint64_t x = ref ^ query;
+	return (x | (x >> 1)) & 0x5555555555555555ULL;
+}
+
+/* number of set bits in a 64-bit word */
+inline int popCount64(uint64_t x)
+{
+#ifdef _MSC_VER
+	return (int)__popcnt64(x);
+#else
+	return __builtin_popcountll(x);
+#endif
+}
+
+/* index of the lowest set bit in a non-zero 64-bit word */
+inline int trailingZeros64(uint64_t x)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, x);
+	return (int)index;
+#else
+	return __builtin_ctzll(x);
+#endif
+}
@@ -0,0 +1,125 @@
+#include "QGramFilter.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OT_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/*
+	portable rejection test, stops at the first target that passes the filter
+
+	@param signatures		=> signatures of count consecutive targets
+	@param count			=> number of targets
+	@param querySignature	=> signature of the query
+	@param maxMissing		=> most q-grams of the query a hit can be missing
+
+	@return true			=> every target misses more than maxMissing of the query's q-grams
+ */
+static bool rejectsScalar(const uint64_t *signatures, unsigned long count, uint64_t querySignature, int maxMissing)
+{
+	for (unsigned long i = 0; i < count; i++)
+	{
+		if (popCount64(querySignature & ~signatures[i]) <= maxMissing)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+#ifdef OT_X86_KERNELS
+/* rejection test using the POPCNT instruction, the portable popcount is a library call without it */
+__attribute__((target("popcnt")))
+static bool rejectsPopcnt(const uint64_t *signatures, unsigned long count, uint64_t querySignature, int maxMissing)
+{
+	for (unsigned long i = 0; i < count; i++)
+	{
+		if ((int)__builtin_popcountll(querySignature & ~signatures[i]) <= maxMissing)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/* rejection test for 8 targets per vector */
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static bool rejectsAvx512(const uint64_t *signatures, unsigned long count, uint64_t querySignature, int maxMissing)
+{
+	const __m512i query = _mm512_set1_epi64((long long)querySignature);
+	const __m512i limit = _mm512_set1_epi64(maxMissing);
+
+	unsigned long i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m512i missing = _mm512_popcnt_epi64(_mm512_andnot_si512(_mm512_loadu_si512((const void *)(signatures + i)), query));
+		if (_mm512_cmple_epi64_mask(missing, limit) != 0)
+		{
+			return false;
+		}
+	}
+	return rejectsScalar(signatures + i, count - i, querySignature, maxMissing);
+}
+#endif
+
+/*
+	selects the fastest implementation of the rejection test supported by the running CPU
+ */
+QGramFilter::QGramFilter()
+{
+	rejectFunction = rejectsScalar;
+
+#ifdef OT_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+	{
+		rejectFunction = rejectsAvx512;
+	}
+	else if (__builtin_cpu_supports("popcnt"))
+	{
+		rejectFunction = rejectsPopcnt;
+	}
+#endif
+}
+
+/*
+	function to compute the signature of every target of a packed store
+
+	@param seqs				=> packed reference targets
+	@param seqLength		=> length of the sequences
+	@param maxMismatches	=> max number of mismatches a hit may have
+ */
+void QGramFilter::build(const PackedSequences &seqs, int seqLength, int maxMismatches)
+{
+	maxMissing = QGRAM_LENGTH * maxMismatches;
+	signatures.resize(seqs.size());
+	for (unsigned long i = 0; i < seqs.size(); i++)
+	{
+		signatures[i] = signature(seqs.getSequence(i), seqLength);
+	}
+	built = true;
+}
+
+/*
+	function to compute the signature of a packed sequence, bit 16a + 4b + c is set if the sequence holds the 3-gram abc
+
+	@param seq			=> packed sequence
+	@param seqLength	=> length of the sequence
+
+	@return signature	=> one bit per 3-gram of the sequence
+ */
+uint64_t QGramFilter::signature(const uint64_t *seq, int seqLength)
+{
+	uint64_t bits = 0;
+	unsigned gram = 0;
+	for (int j = 0; j < seqLength; j++)
+	{
+		int r = seqLength - 1 - j;
+		gram = ((gram << 2) | ((seq[r / 32] >> (2 * (r % 32))) & 3)) & 63;
+		if (j >= QGRAM_LENGTH - 1)
+		{
+			bits |= 1ULL << gram;
+		}
+	}
+	return bits;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "PackedSequences.h"
+
+/* length of the q-grams of a signature, the 4^3 possible 3-grams map to the 64 bits of a word */
+const int QGRAM_LENGTH = 3;
+
+/*
+	QGramFilter rejects reference targets by comparing the sets of q-grams they hold with the query's
+
+	A mismatch changes at most QGRAM_LENGTH of the q-grams of a sequence, so a target within k mismatches of a query
+	still holds every q-gram of the query except at most QGRAM_LENGTH * k of them. Each target keeps a signature with one
+	bit per 3-gram it holds, and a target missing more of the query's 3-grams than that can't be a hit. Signatures are
+	computed when the reference is loaded, and testing a target costs one AND-NOT and a popcount.
+
+	Like MismatchKernel, the test is picked once at construction from the features of the running CPU (AVX-512
+	VPOPCNTDQ, POPCNT or portable scalar code).
+*/
+class QGramFilter
+{
+	public:
+		/* signature shared by all implementations of the rejection test */
+		typedef bool (*RejectFunction)(const uint64_t *signatures, unsigned long count, uint64_t querySignature, int maxMissing);
+
+		/* selects the fastest implementation of the rejection test supported by the running CPU */
+		QGramFilter();
+
+		/* function to compute the signature of every target of a packed store */
+		void build(const PackedSequences &seqs, int seqLength, int maxMismatches);
+
+		/* function to compute the signature of a packed sequence */
+		static uint64_t signature(const uint64_t *seq, int seqLength);
+
+		/* function to check that no target in [first, last) can be within maxMismatches of the query */
+		bool rejects(uint64_t querySignature, unsigned long first, unsigned long last) const
+		{
+			return rejectFunction(signatures.data() + first, last - first, querySignature, maxMissing);
+		}
+
+		/* returns true once the signatures have been computed */
+		bool isBuilt() const { return built; }
+
+	private:
+		/*
+			maxMissing	=> most q-grams of the query a target within maxMismatches can be missing
+			signatures	=> signature of each target, in store order
+		*/
+		RejectFunction rejectFunction;
+		bool built = false;
+		int maxMissing = 0;
+		vector<uint64_t> signatures;
+};
@@ -0,0 +1,419 @@
+#include "ReferenceIndex.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <sys/stat.h>
+
+/* bytes hashed at each end of a source file by fingerprint */
+static const uint64_t FINGERPRINT_SAMPLE_SIZE = 1 << 16;
+
+/* FNV-1a hash of a block of bytes, continuing from hash */
+static uint64_t hashBytes(uint64_t hash, const void *data, uint64_t size)
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	for (uint64_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/* rounds an offset up to the section alignment */
+static uint64_t alignOffset(uint64_t offset)
+{
+	return (offset + REFERENCE_INDEX_ALIGNMENT - 1) / REFERENCE_INDEX_ALIGNMENT * REFERENCE_INDEX_ALIGNMENT;
+}
+
+/*
+	function to lay out the header and sections of an index of the stores
+
+	@param seqLength		=> length of every stored sequence
+	@param csprFingerprint	=> fingerprint of the CSPR file the unique stores were parsed from
+	@param dbFingerprint	=> fingerprint of the DB file the repeat stores were parsed from
+	@param uniqueSeqs		=> packed unique sequences
+	@param uniqueScores		=> scores of the unique sequences
+	@param uniqueLocations	=> chromosomes and locations of the unique sequences
+	@param repeatSeqs		=> packed repeat sequences
+	@param repeatScores		=> scores of the repeat sequences
+	@param repeatLocations	=> chromosomes and locations of the repeat sequences
+	@param repeatGroups		=> groups of repeat sequences sharing a seed
+	@param uniqueFmIndex	=> FM index over the unique sequences, written if both FM indexes are built
+	@param repeatFmIndex	=> FM index over the repeat sequences
+	@param sections			=> filled with the start of each section's data in the stores
+
+	@return fileHeader	=> header of the index, with every section's offset and size
+ */
+ReferenceIndex::Header ReferenceIndex::layout(int seqLength, uint64_t csprFingerprint, uint64_t dbFingerprint, PackedSequences &uniqueSeqs, Column<uint8_t> &uniqueScores, LocationColumn &uniqueLocations, PackedSequences &repeatSeqs, Column<uint8_t> &repeatScores, LocationColumn &repeatLocations, Column<RepeatGroup> &repeatGroups, FmIndex &uniqueFmIndex, FmIndex &repeatFmIndex, const void **sections)
+{
+	/* vars */
+	Header fileHeader;
+
+	sections[UNIQUE_SEQS] = uniqueSeqs.data();
+	sections[UNIQUE_SCORES] = uniqueScores.data();
+	sections[UNIQUE_LOCATIONS] = uniqueLocations.getOffsets().data();
+	sections[UNIQUE_LOCATION_RANGES] = uniqueLocations.getRanges().data();
+	sections[UNIQUE_CHROMS] = uniqueLocations.getChroms().data();
+	sections[REPEAT_SEQS] = repeatSeqs.data();
+	sections[REPEAT_SCORES] = repeatScores.data();
+	sections[REPEAT_LOCATIONS] = repeatLocations.getOffsets().data();
+	sections[REPEAT_LOCATION_RANGES] = repeatLocations.getRanges().data();
+	sections[REPEAT_CHROMS] = repeatLocations.getChroms().data();
+	sections[REPEAT_GROUPS] = repeatGroups.data();
+	sections[UNIQUE_FM_BLOCKS] = uniqueFmIndex.getBlocks().data();
+	sections[UNIQUE_FM_STARTS] = uniqueFmIndex.getStarts().data();
+	sections[UNIQUE_FM_ORDER] = uniqueFmIndex.getOrder().data();
+	sections[REPEAT_FM_BLOCKS] = repeatFmIndex.getBlocks().data();
+	sections[REPEAT_FM_STARTS] = repeatFmIndex.getStarts().data();
+	sections[REPEAT_FM_ORDER] = repeatFmIndex.getOrder().data();
+	sections[UNIQUE_AMBIGUOUS_INDEXES] = uniqueSeqs.getAmbiguousIndexes().data();
+	sections[UNIQUE_AMBIGUOUS_SEQS] = uniqueSeqs.getAmbiguousSeqs().data();
+	sections[REPEAT_AMBIGUOUS_INDEXES] = repeatSeqs.getAmbiguousIndexes().data();
+	sections[REPEAT_AMBIGUOUS_SEQS] = repeatSeqs.getAmbiguousSeqs().data();
+
+	memset(&fileHeader, 0, sizeof(fileHeader));
+	memcpy(fileHeader.magic, "OTIDX", 5);
+	fileHeader.version = REFERENCE_INDEX_VERSION;
+	fileHeader.seqLength = seqLength;
+	fileHeader.csprFingerprint = csprFingerprint;
+	fileHeader.dbFingerprint = dbFingerprint;
+	fileHeader.uniqueCount = uniqueSeqs.size();
+	fileHeader.repeatCount = repeatSeqs.size();
+	fileHeader.repeatGroupCount = repeatGroups.size();
+	fileHeader.sizes[UNIQUE_SEQS] = uniqueSeqs.size() * uniqueSeqs.getWordsPerSeq() * sizeof(uint64_t);
+	fileHeader.sizes[UNIQUE_SCORES] = uniqueScores.size() * sizeof(uint8_t);
+	fileHeader.sizes[UNIQUE_LOCATIONS] = uniqueLocations.getOffsets().size() * sizeof(int32_t);
+	fileHeader.sizes[UNIQUE_LOCATION_RANGES] = uniqueLocations.getRanges().size() * sizeof(LocationRange);
+	fileHeader.sizes[UNIQUE_CHROMS] = uniqueLocations.getChroms().size() * sizeof(int);
+	fileHeader.sizes[REPEAT_SEQS] = repeatSeqs.size() * repeatSeqs.getWordsPerSeq() * sizeof(uint64_t);
+	fileHeader.sizes[REPEAT_SCORES] = repeatScores.size() * sizeof(uint8_t);
+	fileHeader.sizes[REPEAT_LOCATIONS] = repeatLocations.getOffsets().size() * sizeof(int32_t);
+	fileHeader.sizes[REPEAT_LOCATION_RANGES] = repeatLocations.getRanges().size() * sizeof(LocationRange);
+	fileHeader.sizes[REPEAT_CHROMS] = repeatLocations.getChroms().size() * sizeof(int);
+	fileHeader.sizes[REPEAT_GROUPS] = repeatGroups.size() * sizeof(RepeatGroup);
+	fileHeader.sizes[UNIQUE_AMBIGUOUS_INDEXES] = uniqueSeqs.getAmbiguousIndexes().size() * sizeof(uint64_t);
+	fileHeader.sizes[UNIQUE_AMBIGUOUS_SEQS] = uniqueSeqs.getAmbiguousSeqs().size() * sizeof(char);
+	fileHeader.sizes[REPEAT_AMBIGUOUS_INDEXES] = repeatSeqs.getAmbiguousIndexes().size() * sizeof(uint64_t);
+	fileHeader.sizes[REPEAT_AMBIGUOUS_SEQS] = repeatSeqs.getAmbiguousSeqs().size() * sizeof(char);
+	if (uniqueFmIndex.isBuilt() && repeatFmIndex.isBuilt())
+	{
+		fileHeader.flags |= REFERENCE_INDEX_FM;
+		fileHeader.sizes[UNIQUE_FM_BLOCKS] = uniqueFmIndex.getBlocks().size() * sizeof(FmIndex::RankBlock);
+		fileHeader.sizes[UNIQUE_FM_STARTS] = uniqueFmIndex.getStarts().size() * sizeof(uint32_t);
+		fileHeader.sizes[UNIQUE_FM_ORDER] = uniqueFmIndex.getOrder().size() * sizeof(uint32_t);
+		fileHeader.sizes[REPEAT_FM_BLOCKS] = repeatFmIndex.getBlocks().size() * sizeof(FmIndex::RankBlock);
+		fileHeader.sizes[REPEAT_FM_STARTS] = repeatFmIndex.getStarts().size() * sizeof(uint32_t);
+		fileHeader.sizes[REPEAT_FM_ORDER] = repeatFmIndex.getOrder().size() * sizeof(uint32_t);
+	}
+
+	uint64_t offset = alignOffset(sizeof(Header));
+	for (int s = 0; s < SECTION_COUNT; s++)
+	{
+		fileHeader.offsets[s] = offset;
+		offset = alignOffset(offset + fileHeader.sizes[s]);
+	}
+	fileHeader.fileSize = offset;
+	return fileHeader;
+}
+
+/*
+	function to write the stores parsed from a CSPR file and its repeats DB to an index file
+
+	@param indexFilePath	=> file path of the index file to write
+	@param seqLength		=> length of every stored sequence
+	@param csprFingerprint	=> fingerprint of the CSPR file the unique stores were parsed from
+	@param dbFingerprint	=> fingerprint of the DB file the repeat stores were parsed from
+	@param uniqueSeqs		=> packed unique sequences
+	@param uniqueScores		=> scores of the unique sequences
+	@param uniqueLocations	=> chromosomes and locations of the unique sequences
+	@param repeatSeqs		=> packed repeat sequences
+	@param repeatScores		=> scores of the repeat sequences
+	@param repeatLocations	=> chromosomes and locations of the repeat sequences
+	@param repeatGroups		=> groups of repeat sequences sharing a seed
+	@param uniqueFmIndex	=> FM index over the unique sequences, written if both FM indexes are built
+	@param repeatFmIndex	=> FM index over the repeat sequences
+ */
+void ReferenceIndex::write(string &indexFilePath, int seqLength, uint64_t csprFingerprint, uint64_t dbFingerprint, PackedSequences &uniqueSeqs, Column<uint8_t> &uniqueScores, LocationColumn &uniqueLocations, PackedSequences &repeatSeqs, Column<uint8_t> &repeatScores, LocationColumn &repeatLocations, Column<RepeatGroup> &repeatGroups, FmIndex &uniqueFmIndex, FmIndex &repeatFmIndex)
+{
+	/* vars */
+	const void *sections[SECTION_COUNT];
+	Header fileHeader = layout(seqLength, csprFingerprint, dbFingerprint, uniqueSeqs, uniqueScores, uniqueLocations, repeatSeqs, repeatScores, repeatLocations, repeatGroups, uniqueFmIndex, repeatFmIndex, sections);
+	char padding[REFERENCE_INDEX_ALIGNMENT] = {};
+
+	/* write the header and each section padded to the next aligned offset */
+	ofstream file(indexFilePath, ios::binary);
+	if (!file.is_open())
+	{
+		cerr << "Index file couldn't be opened." << endl;
+		exit(-1);
+	}
+	file.write((const char *)&fileHeader, sizeof(fileHeader));
+	file.write(padding, fileHeader.offsets[0] - sizeof(fileHeader));
+	for (int s = 0; s < SECTION_COUNT; s++)
+	{
+		uint64_t end = s + 1 < SECTION_COUNT ? fileHeader.offsets[s + 1] : fileHeader.fileSize;
+		if (fileHeader.sizes[s] > 0)
+		{
+			file.write((const char *)sections[s], fileHeader.sizes[s]);
+		}
+		file.write(padding, end - fileHeader.offsets[s] - fileHeader.sizes[s]);
+	}
+	file.close();
+	if (file.fail())
+	{
+		cerr << "Index file couldn't be written." << endl;
+		exit(-1);
+	}
+}
+
+/*
+	function to write the index of the stores into memory, laid out exactly like an index file
+
+	The magic is written last, so an image that was not finished is never taken for a valid index.
+
+	@param image			=> memory of at least the size returned by a call with a null image, zero filled
+	@param seqLength		=> length of every stored sequence
+	@param csprFingerprint	=> fingerprint of the CSPR file the unique stores were parsed from
+	@param dbFingerprint	=> fingerprint of the DB file the repeat stores were parsed from
+	@param uniqueSeqs		=> packed unique sequences
+	@param uniqueScores		=> scores of the unique sequences
+	@param uniqueLocations	=> chromosomes and locations of the unique sequences
+	@param repeatSeqs		=> packed repeat sequences
+	@param repeatScores		=> scores of the repeat sequences
+	@param repeatLocations	=> chromosomes and locations of the repeat sequences
+	@param repeatGroups		=> groups of repeat sequences sharing a seed
+	@param uniqueFmIndex	=> FM index over the unique sequences, written if both FM indexes are built
+	@param repeatFmIndex	=> FM index over the repeat sequences
+
+	@return size	=> size of the image in bytes
+ */
+uint64_t ReferenceIndex::writeImage(char *image, int seqLength, uint64_t csprFingerprint, uint64_t dbFingerprint, PackedSequences &uniqueSeqs, Column<uint8_t> &uniqueScores, LocationColumn &uniqueLocations, PackedSequences &repeatSeqs, Column<uint8_t> &repeatScores, LocationColumn &repeatLocations, Column<RepeatGroup> &repeatGroups, FmIndex &uniqueFmIndex, FmIndex &repeatFmIndex)
+{
+	/* vars */
+	const void *sections[SECTION_COUNT];
+	Header imageHeader = layout(seqLength, csprFingerprint, dbFingerprint, uniqueSeqs, uniqueScores, uniqueLocations, repeatSeqs, repeatScores, repeatLocations, repeatGroups, uniqueFmIndex, repeatFmIndex, sections);
+
+	if (image == nullptr)
+	{
+		return imageHeader.fileSize;
+	}
+	for (int s = 0; s < SECTION_COUNT; s++)
+	{
+		if (imageHeader.sizes[s] > 0)
+		{
+			memcpy(image + imageHeader.offsets[s], sections[s], imageHeader.sizes[s]);
+		}
+	}
+	char magic[sizeof(imageHeader.magic)];
+	memcpy(magic, imageHeader.magic, sizeof(magic));
+	memset(imageHeader.magic, 0, sizeof(imageHeader.magic));
+	memcpy(image, &imageHeader, sizeof(imageHeader));
+	atomic_thread_fence(memory_order_release);
+	memcpy(image, magic, sizeof(magic));
+	return imageHeader.fileSize;
+}
+
+/*
+	function to map an index file and check its header
+
+	@param indexFilePath	=> file path of the index file
+
+	@return true	=> the index is mapped and its header is valid for this build
+	@return false	=> the file couldn't be read or isn't a valid index of this version, a message is printed
+ */
+bool ReferenceIndex::open(string &indexFilePath)
+{
+	if (!file.open(indexFilePath))
+	{
+		cerr << "Index file " << indexFilePath << " could not be opened." << endl;
+		return false;
+	}
+	return open(file.data(), file.size(), "Index file " + indexFilePath);
+}
+
+/*
+	function to use an index image held in memory, such as a shared memory segment, and check its header
+
+	@param data	=> first byte of the image, must stay mapped as long as the index is used
+	@param size	=> size of the image in bytes
+	@param name	=> description of the image used in messages
+
+	@return true	=> the header is valid for this build
+	@return false	=> the image isn't a complete index of this version, a message is printed
+ */
+bool ReferenceIndex::open(const char *data, uint64_t size, const string &name)
+{
+	base = data;
+	header = (const Header *)data;
+	if (size < sizeof(Header))
+	{
+		cerr << name << " is too short to be an OT index." << endl;
+		return false;
+	}
+
+	/* reject images written by another version or cut short */
+	if (memcmp(header->magic, "OTIDX", 5) != 0 || header->version != REFERENCE_INDEX_VERSION || header->fileSize != size)
+	{
+		cerr << name << " is not a version " << REFERENCE_INDEX_VERSION << " OT index." << endl;
+		return false;
+	}
+	for (int s = 0; s < SECTION_COUNT; s++)
+	{
+		if (header->offsets[s] % REFERENCE_INDEX_ALIGNMENT != 0 || header->sizes[s] > size || header->offsets[s] > size - header->sizes[s])
+		{
+			cerr << name << " is corrupt." << endl;
+			return false;
+		}
+	}
+
+	/* attach trusts the header counts, so every section must hold exactly the values they describe */
+	uint64_t seqBytes = (uint64_t)PackedSequences::wordsFor(header->seqLength) * sizeof(uint64_t);
+	if (!hasCountSections(header->uniqueCount, UNIQUE_SEQS, UNIQUE_SCORES, UNIQUE_LOCATIONS, UNIQUE_LOCATION_RANGES, UNIQUE_CHROMS, UNIQUE_AMBIGUOUS_INDEXES, UNIQUE_AMBIGUOUS_SEQS, seqBytes) ||
+		!hasCountSections(header->repeatCount, REPEAT_SEQS, REPEAT_SCORES, REPEAT_LOCATIONS, REPEAT_LOCATION_RANGES, REPEAT_CHROMS, REPEAT_AMBIGUOUS_INDEXES, REPEAT_AMBIGUOUS_SEQS, seqBytes) ||
+		header->sizes[REPEAT_GROUPS] != header->repeatGroupCount * sizeof(RepeatGroup) ||
+		!hasFmSections(header->uniqueCount, UNIQUE_FM_BLOCKS, UNIQUE_FM_STARTS, UNIQUE_FM_ORDER) ||
+		!hasFmSections(header->repeatCount, REPEAT_FM_BLOCKS, REPEAT_FM_STARTS, REPEAT_FM_ORDER))
+	{
+		cerr << name << " is corrupt." << endl;
+		return false;
+	}
+	return true;
+}
+
+/*
+	function to check that the sections of a store hold the values of count targets
+
+	@param count		=> number of targets of the store in the header
+	@param seqs			=> section of the packed sequences
+	@param scores		=> section of the scores
+	@param locations	=> section of the location offsets
+	@param ranges		=> section of the location ranges
+	@param chroms		=> section of the per target chromosomes, empty when they are kept in the ranges
+	@param ambiguousIndexes	=> section of the indexes of the sequences holding bases other than ACGT
+	@param ambiguousSeqs	=> section of the characters of those sequences
+	@param seqBytes		=> bytes of the packed words of one sequence
+
+	@return true	=> every section size agrees with count and targets have a range to be decoded with
+ */
+bool ReferenceIndex::hasCountSections(uint64_t count, Section seqs, Section scores, Section locations, Section ranges, Section chroms, Section ambiguousIndexes, Section ambiguousSeqs, uint64_t seqBytes) const
+{
+	uint64_t ambiguousCount = header->sizes[ambiguousIndexes] / sizeof(uint64_t);
+	return header->sizes[seqs] == count * seqBytes && header->sizes[scores] == count * sizeof(uint8_t) &&
+		header->sizes[locations] == count * sizeof(int32_t) && header->sizes[ranges] % sizeof(LocationRange) == 0 &&
+		(count == 0 || header->sizes[ranges] > 0) &&
+		(header->sizes[chroms] == 0 || header->sizes[chroms] == count * sizeof(int)) &&
+		header->sizes[ambiguousIndexes] % sizeof(uint64_t) == 0 && ambiguousCount <= count &&
+		header->sizes[ambiguousSeqs] == ambiguousCount * header->seqLength;
+}
+
+/*
+	function to check that the FM index sections of a store hold an index over count targets, or are all empty for an
+	index without REFERENCE_INDEX_FM
+
+	@param count	=> number of targets of the store in the header
+	@param blocks	=> section of the rank blocks
+	@param starts	=> section of the starts of each column
+	@param order	=> section of the order after the last column
+
+	@return true	=> the section sizes agree with count and the flags
+ */
+bool ReferenceIndex::hasFmSections(uint64_t count, Section blocks, Section starts, Section order) const
+{
+	if ((header->flags & REFERENCE_INDEX_FM) == 0)
+	{
+		return header->sizes[blocks] == 0 && header->sizes[starts] == 0 && header->sizes[order] == 0;
+	}
+	return count < UINT32_MAX && header->sizes[blocks] == FmIndex::blocksFor(count) * header->seqLength * sizeof(FmIndex::RankBlock) &&
+		header->sizes[starts] == 4 * (uint64_t)header->seqLength * sizeof(uint32_t) && header->sizes[order] == count * sizeof(uint32_t);
+}
+
+/*
+	function to point the stores at the sections of the mapped index, the index must outlive the stores
+
+	@param uniqueSeqs		=> packed unique sequences
+	@param uniqueScores		=> scores of the unique sequences
+	@param uniqueLocations	=> chromosomes and locations of the unique sequences
+	@param repeatSeqs		=> packed repeat sequences
+	@param repeatScores		=> scores of the repeat sequences
+	@param repeatLocations	=> chromosomes and locations of the repeat sequences
+	@param repeatGroups		=> groups of repeat sequences sharing a seed
+ */
+void ReferenceIndex::attach(PackedSequences &uniqueSeqs, Column<uint8_t> &uniqueScores, LocationColumn &uniqueLocations, PackedSequences &repeatSeqs, Column<uint8_t> &repeatScores, LocationColumn &repeatLocations, Column<RepeatGroup> &repeatGroups) const
+{
+	uniqueSeqs.attach(header->seqLength, header->uniqueCount, (const uint64_t *)getSection(UNIQUE_SEQS));
+	uniqueScores.attach((const uint8_t *)getSection(UNIQUE_SCORES), header->uniqueCount);
+	uniqueLocations.attach((const int32_t *)getSection(UNIQUE_LOCATIONS), header->uniqueCount, (const LocationRange *)getSection(UNIQUE_LOCATION_RANGES), header->sizes[UNIQUE_LOCATION_RANGES] / sizeof(LocationRange), header->sizes[UNIQUE_CHROMS] > 0 ? (const int *)getSection(UNIQUE_CHROMS) : nullptr);
+	uniqueSeqs.attachAmbiguous((const uint64_t *)getSection(UNIQUE_AMBIGUOUS_INDEXES), getSection(UNIQUE_AMBIGUOUS_SEQS), header->sizes[UNIQUE_AMBIGUOUS_INDEXES] / sizeof(uint64_t));
+	repeatSeqs.attach(header->seqLength, header->repeatCount, (const uint64_t *)getSection(REPEAT_SEQS));
+	repeatSeqs.attachAmbiguous((const uint64_t *)getSection(REPEAT_AMBIGUOUS_INDEXES), getSection(REPEAT_AMBIGUOUS_SEQS), header->sizes[REPEAT_AMBIGUOUS_INDEXES] / sizeof(uint64_t));
+	repeatScores.attach((const uint8_t *)getSection(REPEAT_SCORES), header->repeatCount);
+	repeatLocations.attach((const int32_t *)getSection(REPEAT_LOCATIONS), header->repeatCount, (const LocationRange *)getSection(REPEAT_LOCATION_RANGES), header->sizes[REPEAT_LOCATION_RANGES] / sizeof(LocationRange), header->sizes[REPEAT_CHROMS] > 0 ? (const int *)getSection(REPEAT_CHROMS) : nullptr);
+	repeatGroups.attach((const RepeatGroup *)getSection(REPEAT_GROUPS), header->repeatGroupCount);
+}
+
+/*
+	function to point the FM indexes at the sections of the mapped index, the index must outlive them
+
+	@param uniqueFmIndex	=> FM index over the unique sequences
+	@param repeatFmIndex	=> FM index over the repeat sequences
+	@param maxMismatches	=> max number of mismatches a hit may have
+
+	@return true	=> the FM indexes view the mapped sections
+	@return false	=> the index was built without FM sections, the FM indexes are unchanged
+ */
+bool ReferenceIndex::attachFmIndexes(FmIndex &uniqueFmIndex, FmIndex &repeatFmIndex, int maxMismatches) const
+{
+	if ((header->flags & REFERENCE_INDEX_FM) == 0)
+	{
+		return false;
+	}
+	uniqueFmIndex.attach(header->seqLength, header->uniqueCount, (const FmIndex::RankBlock *)getSection(UNIQUE_FM_BLOCKS), (const uint32_t *)getSection(UNIQUE_FM_STARTS), (const uint32_t *)getSection(UNIQUE_FM_ORDER), maxMismatches);
+	repeatFmIndex.attach(header->seqLength, header->repeatCount, (const FmIndex::RankBlock *)getSection(REPEAT_FM_BLOCKS), (const uint32_t *)getSection(REPEAT_FM_STARTS), (const uint32_t *)getSection(REPEAT_FM_ORDER), maxMismatches);
+	return true;
+}
+
+/*
+	function to fingerprint a source file
+
+	Hashing the whole file would cost as much as parsing it, so only its size, modification time and the bytes at
+	both ends are hashed. Any rewrite of the file changes its modification time.
+
+	@param filePath	=> file path of the source file
+
+	@return fingerprint	=> 64-bit hash, 0 if the file can't be read
+ */
+uint64_t ReferenceIndex::fingerprint(string &filePath)
+{
+	/* vars */
+	struct stat fileStat;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	vector<char> sample(FINGERPRINT_SAMPLE_SIZE);
+
+	if (stat(filePath.c_str(), &fileStat) != 0)
+	{
+		return 0;
+	}
+	uint64_t size = fileStat.st_size;
+	int64_t modified = fileStat.st_mtime;
+	hash = hashBytes(hash, &size, sizeof(size));
+	hash = hashBytes(hash, &modified, sizeof(modified));
+
+	ifstream file(filePath, ios::binary);
+	if (!file.is_open())
+	{
+		return 0;
+	}
+	uint64_t head = min(size, FINGERPRINT_SAMPLE_SIZE);
+	file.read(sample.data(), head);
+	hash = hashBytes(hash, sample.data(), head);
+	if (size > head)
+	{
+		uint64_t tail = min(size - head, FINGERPRINT_SAMPLE_SIZE);
+		file.seekg(size - tail);
+		file.read(sample.data(), tail);
+		hash = hashBytes(hash, sample.data(), tail);
+	}
+	return hash;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include "PackedSequences.h"
+#include "Column.h"
+#include "LocationColumn.h"
+#include "MappedFile.h"
+#include "FmIndex.h"
+
+using namespace std;
+
+/* format version written to new index files, files with another version are rejected */
+const uint32_t REFERENCE_INDEX_VERSION = 6;
+
+/* header flag of an index holding the FM index sections of both stores */
+const uint32_t REFERENCE_INDEX_FM = 1;
+
+/* sections are aligned so the mapped packed words and columns can be used in place */
+const uint64_t REFERENCE_INDEX_ALIGNMENT = 64;
+
+/*
+	ReferenceIndex is a precompiled binary copy of a CSPR file and its repeats DB (.otidx)
+
+	The file starts with a fixed header followed by one aligned section per field of the unique and repeat stores:
+	packed sequence words, scores, location offsets, location ranges, per target chromosomes and the sequences holding
+	bases other than ACGT, plus the seed groups of the repeats. Loading maps the file and points the stores at the
+	sections, so startup costs no parsing or copying. The header holds fingerprints of the source files the index was
+	built from so an index that is out of date with them is not used. An index built for the FM engine also holds the
+	rank blocks, starts and order of the FM index of each store, flagged by REFERENCE_INDEX_FM, and those sections are
+	empty otherwise.
+*/
+class ReferenceIndex
+{
+	public:
+		/* sections of the index file in file order */
+		enum Section
+		{
+			UNIQUE_SEQS, UNIQUE_SCORES, UNIQUE_LOCATIONS, UNIQUE_LOCATION_RANGES, UNIQUE_CHROMS,
+			REPEAT_SEQS, REPEAT_SCORES, REPEAT_LOCATIONS, REPEAT_LOCATION_RANGES, REPEAT_CHROMS, REPEAT_GROUPS,
+			UNIQUE_FM_BLOCKS, UNIQUE_FM_STARTS, UNIQUE_FM_ORDER, REPEAT_FM_BLOCKS, REPEAT_FM_STARTS, REPEAT_FM_ORDER,
+			UNIQUE_AMBIGUOUS_INDEXES, UNIQUE_AMBIGUOUS_SEQS, REPEAT_AMBIGUOUS_INDEXES, REPEAT_AMBIGUOUS_SEQS,
+			SECTION_COUNT
+		};
+
+		/*
+			Header of the index file
+			magic			=> "OTIDX" followed by zeros
+			version			=> REFERENCE_INDEX_VERSION of the writer
+			seqLength		=> length of every stored sequence
+			flags			=> REFERENCE_INDEX_FM if the FM index sections are filled
+			csprFingerprint	=> fingerprint of the CSPR file the unique targets were parsed from
+			dbFingerprint	=> fingerprint of the DB file the repeat targets were parsed from
+			uniqueCount		=> number of unique targets
+			repeatCount		=> number of repeat targets
+			repeatGroupCount	=> number of groups of repeat targets sharing a seed
+			offsets/sizes	=> byte offset and size of each section
+			fileSize		=> total size of the file, used to reject truncated files
+		*/
+		struct Header
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t seqLength;
+			uint32_t flags;
+			uint32_t reserved;
+			uint64_t csprFingerprint;
+			uint64_t dbFingerprint;
+			uint64_t uniqueCount;
+			uint64_t repeatCount;
+			uint64_t repeatGroupCount;
+			uint64_t offsets[SECTION_COUNT];
+			uint64_t sizes[SECTION_COUNT];
+			uint64_t fileSize;
+		};
+
+		/* function to write the stores parsed from a CSPR file and its repeats DB to an index file */
+		static void write(string &indexFilePath, int seqLength, uint64_t csprFingerprint, uint64_t dbFingerprint, PackedSequences &uniqueSeqs, Column<uint8_t> &uniqueScores, LocationColumn &uniqueLocations, PackedSequences &repeatSeqs, Column<uint8_t> &repeatScores, LocationColumn &repeatLocations, Column<RepeatGroup> &repeatGroups, FmIndex &uniqueFmIndex, FmIndex &repeatFmIndex);
+
+		/* function to write the index of the stores into memory, returns the size of the image */
+		static uint64_t writeImage(char *image, int seqLength, uint64_t csprFingerprint, uint64_t dbFingerprint, PackedSequences &uniqueSeqs, Column<uint8_t> &uniqueScores, LocationColumn &uniqueLocations, PackedSequences &repeatSeqs, Column<uint8_t> &repeatScores, LocationColumn &repeatLocations, Column<RepeatGroup> &repeatGroups, FmIndex &uniqueFmIndex, FmIndex &repeatFmIndex);
+
+		/* function to map an index file and check its header */
+		bool open(string &indexFilePath);
+
+		/* function to use an index image held in memory and check its header */
+		bool open(const char *data, uint64_t size, const string &name);
+
+		/* function to point the stores at the sections of the mapped index */
+		void attach(PackedSequences &uniqueSeqs, Column<uint8_t> &uniqueScores, LocationColumn &uniqueLocations, PackedSequences &repeatSeqs, Column<uint8_t> &repeatScores, LocationColumn &repeatLocations, Column<RepeatGroup> &repeatGroups) const;
+
+		/* function to point the FM indexes at the sections of the mapped index, returns false if it has none */
+		bool attachFmIndexes(FmIndex &uniqueFmIndex, FmIndex &repeatFmIndex, int maxMismatches) const;
+
+		/* returns the header of the mapped index */
+		const Header &getHeader() const { return *header; }
+
+		/* function to fingerprint a source file from its size, modification time and the bytes at both ends */
+		static uint64_t fingerprint(string &filePath);
+
+	private:
+		/*
+			file	=> mapped index file, unused when the index is an image in memory
+			base	=> first byte of the index, starting with the header
+		*/
+		MappedFile file;
+		const char *base = nullptr;
+		const Header *header = nullptr;
+
+		/* function to lay out the header and sections of an index of the stores */
+		static Header layout(int seqLength, uint64_t csprFingerprint, uint64_t dbFingerprint, PackedSequences &uniqueSeqs, Column<uint8_t> &uniqueScores, LocationColumn &uniqueLocations, PackedSequences &repeatSeqs, Column<uint8_t> &repeatScores, LocationColumn &repeatLocations, Column<RepeatGroup> &repeatGroups, FmIndex &uniqueFmIndex, FmIndex &repeatFmIndex, const void **sections);
+
+		/* function to check that the sections of a store hold the values of count targets */
+		bool hasCountSections(uint64_t count, Section seqs, Section scores, Section locations, Section ranges, Section chroms, Section ambiguousIndexes, Section ambiguousSeqs, uint64_t seqBytes) const;
+
+		/* function to check that the FM index sections of a store hold an index over count targets, or are empty */
+		bool hasFmSections(uint64_t count, Section blocks, Section starts, Section order) const;
+
+		/* function to get the start of a mapped section */
+		const char *getSection(Section section) const { return base + header->offsets[section]; }
+};
@@ -1,96 +1,130 @@
 #include "Score.h"
 
 #include <iostream>
+#include <cmath>
+#include <algorithm>
 using namespace std;
 
 /*
-	function for calculating the sh score
-
-	@param mismatches	=> locations of the mismatches found between 2 sequences
-	@param hsuKeys		=> keys for indexing into the HSU matrix
-	@param hsuMatrix	=> 2D HSU matrix
- 	@param gRNA_length	=> length of gRNA sequence
-
-	@return tot_sh	=> final sh score
+	function to compile HSU rows keyed by two character strings into the table
 
+	@param rows			=> HSU rows keyed by reference base + complemented query base, e.g. "GT"
+	@param minColumns	=> smallest number of columns the table must have
 */
-double Score::shScore(vector<int> &mismatches, vector<string> &hsuKeys, map<string, vector<double>> &hsuMatrix, int &gRNA_length)
+void HsuMatrix::compile(map<string, vector<double> > &rows, int minColumns)
 {
-	double tot_sh = 1.0;
-	for (int i = 0; i < mismatches.size(); i++)
+	static const string bases = "ACGT";
+
+	columns = minColumns;
+	for (map<string, vector<double> >::iterator row = rows.begin(); row != rows.end(); row++)
 	{
-		tot_sh *= hsuMatrix[hsuKeys[i]][gRNA_length - mismatches[i]];
+		columns = max(columns, (int)row->second.size());
+	}
+
+	values.assign(16 * columns, 1.0);
+	for (map<string, vector<double> >::iterator row = rows.begin(); row != rows.end(); row++)
+	{
+		if (row->first.length() != 2 || bases.find(row->first[0]) == string::npos || bases.find(row->first[1]) == string::npos)
+		{
+			continue;
+		}
+		int key = getKey((int)bases.find(row->first[0]), (int)bases.find(row->first[1]));
+		copy(row->second.begin(), row->second.end(), values.begin() + key * columns);
 	}
-	return tot_sh;
 }
 
 /*
-	function for calculating the ss score
+	function to precompute the per position tables used by offTargetScore
 
-	@param mismatches	=> locations of the mismatches found between 2 sequences
+	@param hsuMatrix	=> compiled HSU matrix
 	@param gRNA_length	=> length of gRNA sequence
-
-	@return tot_ss	=> final ss score
-
 */
-double Score::ssScore(vector<int> &mismatches, int &gRNA_length)
+void Score::init(HsuMatrix &hsuMatrix, int gRNA_length)
 {
-	double tot_ss = 1.0;
-	
-	if (gRNA_length == 24)
+	columns = gRNA_length + 1;
+	stTable.assign(columns, 0.0);
+	ssTable.assign(columns, 0.0);
+	shTable.assign(16 * columns, 1.0);
+
+	/* st subtracts 1 / location, ss subtracts a penalty by location range that depends on the endo's sequence length */
+	for (int location = 1; location <= gRNA_length; location++)
 	{
-		for (int i = 0; i < mismatches.size(); i++)
+		stTable[location] = 1.0 / location;
+		if (gRNA_length == 24)
 		{
-			if (mismatches[i] <= 8)
-			{
-				tot_ss -= 0.1;
-			}
-			else if (mismatches[i] <= 20)
-			{
-				tot_ss -= 0.0125;
-			}
-			else
-			{
-				tot_ss -= 0;
-			}
+			ssTable[location] = location <= 8 ? 0.1 : (location <= 20 ? 0.0125 : 0.0);
+		}
+		else
+		{
+			ssTable[location] = location <= 6 ? 0.1 : (location <= 12 ? 0.05 : 0.0125);
+		}
+		for (int key = 0; key < 16; key++)
+		{
+			shTable[key * columns + location] = hsuMatrix.get(key, gRNA_length - location);
 		}
 	}
-	else
+
+	/*
+		score bounds: with c mismatches at distinct locations st is largest for the c highest locations, sh for the
+		c largest per location HSU values and ss^6 at one end of the range the c smallest or largest penalties give
+	*/
+	vector<double> stSmallest(stTable.begin() + 1, stTable.end());
+	vector<double> ssSmallest(ssTable.begin() + 1, ssTable.end());
+	vector<double> shLargest(gRNA_length, 0.0);
+	for (int location = 1; location <= gRNA_length; location++)
 	{
-		for (int i = 0; i < mismatches.size(); i++)
+		/* every key, not only mismatch keys, since a base other than ACGT is packed as A and may mismatch with a match key */
+		for (int key = 0; key < 16; key++)
 		{
-			if (mismatches[i] <= 6)
-			{
-				tot_ss -= 0.1;
-			}
-			else if (mismatches[i] <= 12)
-			{
-				tot_ss -= 0.05;
-			}
-			else
-			{
-				tot_ss -= 0.0125;
-			}
+			shLargest[location - 1] = max(shLargest[location - 1], shTable[key * columns + location]);
 		}
 	}
+	sort(stSmallest.begin(), stSmallest.end());
+	sort(ssSmallest.begin(), ssSmallest.end());
+	sort(shLargest.rbegin(), shLargest.rend());
 
-	return tot_ss;
+	double st = 3.547, sh = 1.0, ssHigh = 1.0, ssLow = 1.0;
+	boundTable.assign(columns, 0.0);
+	for (int count = 0; count <= gRNA_length; count++)
+	{
+		if (count > 0)
+		{
+			st -= stSmallest[count - 1];
+			sh *= shLargest[count - 1];
+			ssHigh -= ssSmallest[count - 1];
+			ssLow -= ssSmallest[gRNA_length - count];
+		}
+		/* small relative margin so rounding in offTargetScore can never exceed the bound */
+		boundTable[count] = max(0.0, sqrt(sh) + st / 3.5477) * max(pow(ssHigh, 6), pow(ssLow, 6)) / 8 * (1 + 1e-9);
+	}
 }
 
 /*
-	function for calculating the st score
+	function for calculating the st, sh and ss scores of a hit in one pass and combining them into its off-target score
 
-	@param mismatches	=> locations of the mismatches found between 2 sequences
+	Each sub-score accumulates its per position table entries in the order of the mismatches, so a hit always gets the
+	same score whichever engine found it.
 
-	@return tot_st	=> final st score
+	@param mismatches		=> locations of the mismatches found between 2 sequences
+	@param hsuKeys			=> keys for indexing into the HSU matrix
+	@param mismatchCount	=> number of mismatches
+	@param ratioTerm		=> (reference on-target score / query on-target score)^2
 
+	@return off-target score of the hit
 */
-double Score::stScore(vector<int> &mismatches)
+double Score::offTargetScore(const int *mismatches, const uint8_t *hsuKeys, int mismatchCount, double ratioTerm) const
 {
 	double tot_st = 3.547;
-	for (int i = 0; i < mismatches.size(); i++)
+	double tot_sh = 1.0;
+	double tot_ss = 1.0;
+	for (int i = 0; i < mismatchCount; i++)
 	{
-		tot_st -= (1.0 / (mismatches[i]));
+		tot_st -= stTable[mismatches[i]];
+		tot_sh *= shTable[hsuKeys[i] * columns + mismatches[i]];
+		tot_ss -= ssTable[mismatches[i]];
 	}
-	return tot_st / 3.5477;
-}
\ No newline at end of file
+
+	double value = (sqrt(tot_sh) + tot_st / 3.5477) * ratioTerm * pow(tot_ss, 6);
+	value /= 4;
+	return value / 2;
+}
@@ -6,15 +6,52 @@
 
 using namespace std;
 
+/*
+	HsuMatrix holds the HSU matrix as one contiguous table indexed by (key, column)
+
+	A key is the 2-bit code of the reference base times 4 plus the 2-bit code of the complemented query base
+	(A=0, C=1, G=2, T=3), so the mismatch "GT" has key 2 * 4 + 3. Keys not present in CASPERinfo score 1.0.
+*/
+class HsuMatrix
+{
+	public:
+		/* function to compile HSU rows keyed by two character strings into the table */
+		void compile(map<string, vector<double> > &rows, int minColumns);
+
+		/* returns the HSU value of a key at a column */
+		double get(int key, int column) const { return values[key * columns + column]; }
+
+		/* returns the key of a reference base code and a complemented query base code */
+		static int getKey(int refCode, int complementCode) { return refCode * 4 + complementCode; }
+
+	private:
+		int columns = 0;
+		vector<double> values;
+};
+
 class Score
 {
 	public:
-		/* function for calculating the sh score */
-		double shScore(vector<int> &mismatches, vector<string> &hsuKeys, map<string, vector<double >> &hsuMatrix, int &gRNA_length);
+		/* function to precompute the per position tables used by offTargetScore */
+		void init(HsuMatrix &hsuMatrix, int gRNA_length);
+
+		/* function for calculating the st, sh and ss scores of a hit in one pass and combining them into its off-target score */
+		double offTargetScore(const int *mismatches, const uint8_t *hsuKeys, int mismatchCount, double ratioTerm) const;
 
-		/* function for calculating the ss score */
-		double ssScore(vector<int> &mismatches, int &gRNA_length);
+		/* returns an upper bound of offTargetScore / ratioTerm for any hit with the given number of mismatches */
+		double scoreBound(int mismatchCount) const { return boundTable[mismatchCount]; }
 
-		/* function for calculating the st score */
-		double stScore(vector<int> &mismatches);
+	private:
+		/*
+			Per position table definitions, indexed by mismatch location 1..gRNA_length
+			stTable	=> 1 / location subtracted by the st score
+			ssTable	=> amount subtracted by the ss score for the endo's sequence length
+			shTable	=> HSU value of each key, key * (gRNA_length + 1) + location
+			boundTable	=> upper bound of offTargetScore / ratioTerm indexed by mismatch count 0..gRNA_length
+		*/
+		int columns = 0;
+		vector<double> stTable;
+		vector<double> ssTable;
+		vector<double> shTable;
+		vector<double> boundTable;
 };
@@ -0,0 +1,134 @@
+#include "SeedIndex.h"
+#include <algorithm>
+#include <cmath>
+
+/*
+	function to split the sequence into maxMismatches + 1 disjoint segments, longer segments first
+
+	@param seqLength		=> length of the sequences
+	@param maxMismatches	=> max number of mismatches a hit may have
+	@param starts			=> filled with the first base of each segment
+	@param lengths			=> filled with the number of bases of each segment used as its key
+ */
+void SeedIndex::getSegments(int seqLength, int maxMismatches, vector<int> &starts, vector<int> &lengths)
+{
+	int segmentCount = maxMismatches + 1;
+	int start = 0;
+	for (int i = 0; i < segmentCount; i++)
+	{
+		int length = seqLength / segmentCount + (i < seqLength % segmentCount ? 1 : 0);
+		starts.push_back(start);
+		lengths.push_back(min(length, SEED_INDEX_MAX_KEY_LENGTH));
+		start += length;
+	}
+}
+
+/*
+	function to estimate the fraction of targets returned as candidates for a random query
+
+	@param seqLength		=> length of the sequences
+	@param maxMismatches	=> max number of mismatches a hit may have
+
+	@return fraction	=> expected candidates / targets, 1 if the segments are too short to index
+ */
+double SeedIndex::candidateFraction(int seqLength, int maxMismatches)
+{
+	vector<int> starts, lengths;
+	double fraction = 0.0;
+	if (maxMismatches + 1 > seqLength)
+	{
+		return 1.0;
+	}
+	getSegments(seqLength, maxMismatches, starts, lengths);
+	for (unsigned long i = 0; i < lengths.size(); i++)
+	{
+		fraction += pow(0.25, lengths[i]);
+	}
+	return min(fraction, 1.0);
+}
+
+/*
+	function to read the key of a segment from a packed sequence
+
+	@param seq		=> packed sequence
+	@param segment	=> segment to read
+
+	@return key	=> 2-bit codes of the segment's key bases
+ */
+uint32_t SeedIndex::getKey(const uint64_t *seq, int segment) const
+{
+	int bit = 2 * (seqLength - segmentStarts[segment] - keyLengths[segment]);
+	int bitCount = 2 * keyLengths[segment];
+	int word = bit / 64;
+	int shift = bit % 64;
+	uint64_t value = seq[word] >> shift;
+	if (shift + bitCount > 64)
+	{
+		value |= seq[word + 1] << (64 - shift);
+	}
+	return (uint32_t)(value & ((1ULL << bitCount) - 1));
+}
+
+/*
+	function to build the index over a packed store
+
+	@param seqs				=> packed reference targets
+	@param length			=> length of the sequences
+	@param maxMismatches	=> max number of mismatches a hit may have
+ */
+void SeedIndex::build(const PackedSequences &seqs, int length, int maxMismatches)
+{
+	/* target indexes are stored as 32-bit values */
+	if (seqs.size() > UINT32_MAX || maxMismatches + 1 > length)
+	{
+		return;
+	}
+
+	seqLength = length;
+	segmentStarts.clear();
+	keyLengths.clear();
+	getSegments(seqLength, maxMismatches, segmentStarts, keyLengths);
+	offsets.assign(segmentStarts.size(), vector<uint32_t>());
+	targets.assign(segmentStarts.size(), vector<uint32_t>());
+
+	/* counting sort of the targets by each segment's key keeps every run in ascending target order */
+	for (unsigned long s = 0; s < segmentStarts.size(); s++)
+	{
+		offsets[s].assign((1UL << (2 * keyLengths[s])) + 1, 0);
+		for (unsigned long i = 0; i < seqs.size(); i++)
+		{
+			offsets[s][getKey(seqs.getSequence(i), s) + 1]++;
+		}
+		for (unsigned long k = 1; k < offsets[s].size(); k++)
+		{
+			offsets[s][k] += offsets[s][k - 1];
+		}
+
+		vector<uint32_t> next(offsets[s].begin(), offsets[s].end() - 1);
+		targets[s].resize(seqs.size());
+		for (unsigned long i = 0; i < seqs.size(); i++)
+		{
+			targets[s][next[getKey(seqs.getSequence(i), s)]++] = (uint32_t)i;
+		}
+	}
+	built = true;
+}
+
+/*
+	function to collect the targets sharing at least one segment with the query
+
+	@param querySeq		=> packed query sequence
+	@param candidates	=> filled with the candidate target indexes in ascending order without duplicates
+ */
+void SeedIndex::getCandidates(const uint64_t *querySeq, vector<unsigned long> &candidates) const
+{
+	candidates.clear();
+	for (unsigned long s = 0; s < segmentStarts.size(); s++)
+	{
+		uint32_t key = getKey(querySeq, s);
+		size_t middle = candidates.size();
+		candidates.insert(candidates.end(), targets[s].begin() + offsets[s][key], targets[s].begin() + offsets[s][key + 1]);
+		inplace_merge(candidates.begin(), candidates.begin() + middle, candidates.end());
+	}
+	candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "PackedSequences.h"
+
+/* longest segment used as an index key, 4^10 buckets per segment */
+const int SEED_INDEX_MAX_KEY_LENGTH = 10;
+
+/*
+	SeedIndex maps each of k + 1 disjoint segments of the reference targets to the targets holding them
+
+	By the pigeonhole principle a target with at most k mismatches against a query matches it exactly on at least one
+	of k + 1 disjoint segments, so only the targets sharing a segment with the query need to be compared.
+*/
+class SeedIndex
+{
+	public:
+		/* function to build the index over a packed store */
+		void build(const PackedSequences &seqs, int seqLength, int maxMismatches);
+
+		/* function to collect the targets sharing at least one segment with the query */
+		void getCandidates(const uint64_t *querySeq, vector<unsigned long> &candidates) const;
+
+		/* function to estimate the fraction of targets returned as candidates for a random query */
+		static double candidateFraction(int seqLength, int maxMismatches);
+
+		/* returns true once the index has been built */
+		bool isBuilt() const { return built; }
+
+	private:
+		/*
+			segmentStarts	=> first base of each segment
+			keyLengths		=> number of bases of each segment used as its key
+			offsets			=> per segment, start of each key's run in targets (4^keyLength + 1 entries)
+			targets			=> per segment, target indexes grouped by key in ascending order
+		*/
+		bool built = false;
+		int seqLength = 0;
+		vector<int> segmentStarts;
+		vector<int> keyLengths;
+		vector<vector<uint32_t> > offsets;
+		vector<vector<uint32_t> > targets;
+
+		/* function to split the sequence into maxMismatches + 1 segments */
+		static void getSegments(int seqLength, int maxMismatches, vector<int> &starts, vector<int> &lengths);
+
+		/* function to read the key of a segment from a packed sequence */
+		uint32_t getKey(const uint64_t *seq, int segment) const;
+};
@@ -0,0 +1,336 @@
+#include "Server.h"
+#include <fstream>
+#include <thread>
+#include <cstring>
+#ifndef _WIN32
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+/*
+	function for loading every organism listed in the organisms file
+
+	Each line holds name;endo;csprFile;sqlFile;casperInfoFile;maxMismatches;hsuMatrixName followed by any optional
+	arguments of a normal run (--engine, --threads, --index, ...), empty lines and lines starting with # are skipped.
+
+	@param organismsFilePath	=> file path of the organisms file
+ */
+void Server::loadOrganisms(string &organismsFilePath)
+{
+	/* vars */
+	string line;
+	ifstream organismsFile(organismsFilePath);
+
+	if (!organismsFile.is_open())
+	{
+		cerr << "Organisms file was unable to be opened." << endl;
+		exit(-1);
+	}
+	while (getline(organismsFile, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		vector<string> fields = FileOperations::split(line, ';');
+		string name = fields[0];
+		fields.erase(fields.begin());
+		unique_ptr<OffTarget> organism(new OffTarget());
+		if (name.empty() || organisms.count(name) > 0 || !organism->parseOrganismArguments(fields))
+		{
+			cerr << "Invalid organisms file line: " << line << endl;
+			exit(-1);
+		}
+
+		cerr << "Loading organism " << name << endl;
+		organism->loadReference();
+		organisms[name] = move(organism);
+	}
+	if (organisms.empty())
+	{
+		cerr << "Organisms file contained no organisms" << endl;
+		exit(-1);
+	}
+}
+
+/*
+	function for serving requests read from stdin, writing the responses to stdout
+ */
+void Server::serveStdio()
+{
+	serveSession([](string &line)
+	{
+		return (bool)getline(cin, line);
+	},
+	[](const string &block)
+	{
+		cout << block << flush;
+	});
+}
+
+/*
+	function for serving requests of every connection made to a Unix domain socket, each on its own thread
+
+	@param socketPath	=> file path of the socket, replaced if it already exists
+ */
+void Server::serveSocket(string &socketPath)
+{
+#ifdef _WIN32
+	cerr << "Unix domain sockets are not supported on this platform, serve over stdin/stdout instead." << endl;
+	exit(-1);
+#else
+	/* vars */
+	sockaddr_un address;
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (listener < 0 || socketPath.size() >= sizeof(address.sun_path))
+	{
+		cerr << "Socket " << socketPath << " couldn't be created." << endl;
+		exit(-1);
+	}
+	strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+	/* a client closing its connection early must not end the server */
+	signal(SIGPIPE, SIG_IGN);
+	unlink(socketPath.c_str());
+	if (bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, SERVER_BACKLOG) != 0)
+	{
+		cerr << "Socket " << socketPath << " couldn't be bound: " << strerror(errno) << endl;
+		exit(-1);
+	}
+	cerr << "Listening on " << socketPath << endl;
+
+	while (true)
+	{
+		int connection = accept(listener, nullptr, nullptr);
+		if (connection < 0)
+		{
+			if (errno != EINTR)
+			{
+				cerr << "Accepting a connection failed: " << strerror(errno) << endl;
+			}
+			continue;
+		}
+		thread(&Server::serveConnection, this, connection).detach();
+	}
+#endif
+}
+
+/*
+	function for serving a socket connection until QUIT or until the client closes it
+
+	@param connection	=> connected socket, closed when the session ends
+ */
+void Server::serveConnection(int connection)
+{
+#ifndef _WIN32
+	/* vars */
+	string buffer;
+	unsigned long position = 0;
+	bool closed = false;
+	vector<char> chunk(SERVER_READ_SIZE);
+
+	serveSession([&](string &line)
+	{
+		while (true)
+		{
+			size_t end = buffer.find('\n', position);
+			if (end != string::npos)
+			{
+				line.assign(buffer, position, end - position);
+				position = end + 1;
+				return true;
+			}
+
+			/* drop consumed lines before reading more */
+			buffer.erase(0, position);
+			position = 0;
+			ssize_t count = read(connection, chunk.data(), chunk.size());
+			if (count < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (count <= 0)
+			{
+				/* a last line without a newline still counts */
+				line = buffer;
+				buffer.clear();
+				return !line.empty();
+			}
+			buffer.append(chunk.data(), count);
+		}
+	},
+	[&](const string &block)
+	{
+		unsigned long written = 0;
+		while (!closed && written < block.size())
+		{
+			ssize_t count = write(connection, block.data() + written, block.size() - written);
+			if (count < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (count <= 0)
+			{
+				/* the client is gone, the rest of the request is scored and dropped */
+				closed = true;
+			}
+			else
+			{
+				written += count;
+			}
+		}
+	});
+	close(connection);
+#endif
+}
+
+/*
+	function for serving the requests of one session until QUIT or the end of its input
+
+	@param readLine	=> reads the next line of the session without its newline, returns false at the end of the input
+	@param write	=> writes a block of response lines to the session
+ */
+void Server::serveSession(const function<bool(string &)> &readLine, const function<void(const string &)> &write)
+{
+	/* vars */
+	string line;
+
+	while (readLine(line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		vector<string> request = FileOperations::split(line, ' ');
+		if (line.empty())
+		{
+			continue;
+		}
+		else if (request[0] == "QUIT")
+		{
+			return;
+		}
+		else if (request[0] == "RUN")
+		{
+			runRequest(request, readLine, write);
+		}
+		else
+		{
+			write("ERROR Unknown request: " + request[0] + "\n");
+		}
+	}
+}
+
+/*
+	function for reading the query lines of a RUN request up to its END line and scoring them
+
+	The query lines are always read up to END, so a request with an error leaves the session in sync for the next one.
+
+	@param request	=> words of the RUN line
+	@param readLine	=> reads the next line of the session
+	@param write	=> writes a block of response lines to the session
+ */
+void Server::runRequest(vector<string> &request, const function<bool(string &)> &readLine, const function<void(const string &)> &write)
+{
+	/* vars */
+	string line, error;
+	OffTarget::QueryBatch queryBatch;
+	OffTarget *organism = nullptr;
+
+	if (request.size() < 2 || organisms.count(request[1]) == 0)
+	{
+		error = "Unknown organism";
+	}
+	else
+	{
+		organism = organisms.find(request[1])->second.get();
+	}
+	for (unsigned long i = 2; i < request.size() && error.empty(); i++)
+	{
+		size_t split = request[i].find('=');
+		string name = request[i].substr(0, split);
+		string value = split == string::npos ? "" : request[i].substr(split + 1);
+
+		if (request[i].empty())
+		{
+			continue;
+		}
+		else if (name == "--threshold" && !value.empty() && atof(value.c_str()) >= 0)
+		{
+			queryBatch.threshold = atof(value.c_str());
+		}
+		else if (name == "--top-k" && atol(value.c_str()) > 0)
+		{
+			queryBatch.topK = (unsigned long)atol(value.c_str());
+		}
+		else if (request[i] == "--avg")
+		{
+			queryBatch.avgOutput = true;
+		}
+		else
+		{
+			error = "Invalid request option: " + request[i];
+		}
+	}
+
+	/* read the query lines, chrom;sequence;PAM;score, up to END */
+	while (true)
+	{
+		if (!readLine(line))
+		{
+			return;
+		}
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		if (line == "END")
+		{
+			break;
+		}
+		if (!error.empty() || line.empty())
+		{
+			continue;
+		}
+
+		vector<string> fields = FileOperations::split(line, ';');
+		int queryScore = fields.size() >= 4 ? atoi(fields[3].c_str()) : 0;
+		if (fields.size() < 4 || (int)fields[1].size() != organism->getSeqLength() || fields[1].find_first_not_of("ACGT") != string::npos)
+		{
+			error = "Invalid query line: " + line;
+		}
+		else if (queryScore < 1 || queryScore > 255)
+		{
+			error = "Invalid query score: " + line;
+		}
+		else
+		{
+			queryBatch.querySeqs += fields[1];
+			queryBatch.queryScores.push_back((uint8_t)queryScore);
+		}
+	}
+	if (error.empty() && queryBatch.queryScores.empty())
+	{
+		error = "Request contained no sequences";
+	}
+	if (!error.empty())
+	{
+		write("ERROR " + error + "\n");
+		return;
+	}
+
+	write(queryBatch.avgOutput ? "AVG OUTPUT\n" : "DETAILED OUTPUT\n");
+	organism->runBatch(queryBatch, write);
+	write("DONE\n");
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "OffTarget.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+
+using namespace std;
+
+/* bytes read from a connection at a time */
+const unsigned long SERVER_READ_SIZE = 1UL << 16;
+
+/* pending connections the socket queues before accept */
+const int SERVER_BACKLOG = 16;
+
+/*
+	Server keeps the reference data of one or more organisms loaded and scores query batches sent over stdin/stdout or
+	a Unix domain socket, so the CSPR and DB files are parsed once instead of on every run
+
+	Requests are line based:
+		RUN organism [--threshold=X] [--top-k=N] [--avg]	starts a request, followed by query lines in query file format
+		END													ends the query lines, the batch is scored and its results streamed back
+		QUIT												closes the session
+	A request is answered with the output file contents, DETAILED OUTPUT or AVG OUTPUT followed by each query's block
+	as soon as it and every earlier query are scored, then a DONE line. Invalid requests are answered with a single
+	ERROR line. Each socket connection is served on its own thread and concurrent requests share the loaded
+	reference, each scoring its batch on its own thread pool.
+*/
+class Server
+{
+	public:
+		/* function for loading every organism listed in the organisms file */
+		void loadOrganisms(string &organismsFilePath);
+
+		/* function for serving requests read from stdin, writing the responses to stdout */
+		void serveStdio();
+
+		/* function for serving requests of every connection made to a Unix domain socket */
+		void serveSocket(string &socketPath);
+
+	private:
+		/* organisms => loaded OffTarget objects by organism name */
+		map<string, unique_ptr<OffTarget> > organisms;
+
+		/* function for serving the requests of one session until QUIT or the end of its input */
+		void serveSession(const function<bool(string &)> &readLine, const function<void(const string &)> &write);
+
+		/* function for reading the query lines of a request and scoring them */
+		void runRequest(vector<string> &request, const function<bool(string &)> &readLine, const function<void(const string &)> &write);
+
+		/* function for serving a socket connection */
+		void serveConnection(int connection);
+};
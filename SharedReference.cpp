@@ -0,0 +1,364 @@
+#include "SharedReference.h"
+#include "ReferenceIndex.h"
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <dirent.h>
+#endif
+
+map<string, shared_ptr<SharedReference::Segment> > SharedReference::openSegments;
+mutex SharedReference::segmentsLock;
+condition_variable SharedReference::segmentsChanged;
+
+#ifndef _WIN32
+/* byte locked exclusively by the process publishing the image, never locked shared */
+const off_t PUBLISH_LOCK_BYTE = 0;
+
+/* byte locked shared by every process using the segment, counting its users */
+const off_t USER_LOCK_BYTE = 1;
+
+/*
+	takes, changes or releases this process's lock on one byte of the segment, retrying when interrupted by a signal
+
+	@param fd		=> descriptor of the segment
+	@param byte		=> byte to lock
+	@param type		=> F_RDLCK, F_WRLCK or F_UNLCK
+	@param wait		=> true to wait for conflicting locks of other processes to be released
+
+	@return 0	=> the lock was taken
+ */
+static int lockByte(int fd, off_t byte, short type, bool wait)
+{
+	struct flock lock;
+	int result;
+
+	memset(&lock, 0, sizeof(lock));
+	lock.l_type = type;
+	lock.l_whence = SEEK_SET;
+	lock.l_start = byte;
+	lock.l_len = 1;
+	do
+	{
+		result = fcntl(fd, wait ? F_SETLKW : F_SETLK, &lock);
+	} while (result != 0 && errno == EINTR);
+	return result;
+}
+#endif
+
+/*
+	unmaps the segment and removes it if this was the last process using it
+ */
+SharedReference::~SharedReference()
+{
+	close();
+}
+
+/*
+	function to unmap the segment and remove it if this was the last process using it, the segment stays open while
+	other objects of this process use it
+ */
+void SharedReference::close()
+{
+#ifndef _WIN32
+	if (segment == nullptr)
+	{
+		return;
+	}
+	lock_guard<mutex> guard(segmentsLock);
+	if (--segment->users == 0 && segment->fd >= 0)
+	{
+		unmap();
+
+		/* an unpublished segment is still being published by this process, otherwise no other user lock means no user */
+		if (!segment->published || lockByte(segment->fd, USER_LOCK_BYTE, F_WRLCK, false) == 0)
+		{
+			shm_unlink(name.c_str());
+		}
+		::close(segment->fd);
+		segment->fd = -1;
+		openSegments.erase(name);
+		segmentsChanged.notify_all();
+	}
+	segment.reset();
+#endif
+}
+
+/*
+	function to open or create the segment of a reference
+
+	If the segment holds a published image it is mapped read-only and the user lock is kept on it. Otherwise this
+	process takes the publish lock and publishes the reference itself, processes opening the segment meanwhile wait
+	for that lock and attach to the image instead of loading the reference too. The publish lock is only ever taken
+	exclusively, so waiting for it never waits for other users of the segment. An object of this process opening a
+	segment another one has open shares it, waiting for it to be published first.
+
+	@param seqLength		=> length of every stored sequence
+	@param csprFingerprint	=> fingerprint of the CSPR file
+	@param dbFingerprint	=> fingerprint of the DB file
+
+	@return true	=> the segment is open, check isPublished
+	@return false	=> shared memory isn't available, a message is printed
+ */
+bool SharedReference::open(int seqLength, uint64_t csprFingerprint, uint64_t dbFingerprint)
+{
+#ifdef _WIN32
+	cerr << "Shared memory is not supported on this platform." << endl;
+	return false;
+#else
+	/* vars */
+	ostringstream segmentName;
+	struct stat segmentStat;
+
+	close();
+	segmentName << "/OT-v" << REFERENCE_INDEX_VERSION << "-" << seqLength << "-" << hex << csprFingerprint << "-" << dbFingerprint;
+	name = segmentName.str();
+
+	unique_lock<mutex> guard(segmentsLock);
+	while (openSegments.count(name) > 0 && !openSegments[name]->published)
+	{
+		segmentsChanged.wait(guard);
+	}
+	if (openSegments.count(name) > 0)
+	{
+		segment = openSegments[name];
+		segment->users++;
+		return true;
+	}
+	removeUnusedSegments();
+
+	segment = make_shared<Segment>();
+	int &fd = segment->fd;
+	while (true)
+	{
+		bool created = false;
+		fd = shm_open(name.c_str(), O_RDWR, 0600);
+		if (fd < 0 && errno == ENOENT)
+		{
+			fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+			created = true;
+			if (fd < 0 && errno == EEXIST)
+			{
+				continue;
+			}
+		}
+		if (fd < 0)
+		{
+			break;
+		}
+
+		/* nobody holds the user lock of a segment left behind by a killed process, remove it and create a new one */
+		if (!created && lockByte(fd, USER_LOCK_BYTE, F_WRLCK, false) == 0)
+		{
+			shm_unlink(name.c_str());
+			::close(fd);
+			continue;
+		}
+		if (lockByte(fd, USER_LOCK_BYTE, F_RDLCK, true) != 0 || fstat(fd, &segmentStat) != 0)
+		{
+			break;
+		}
+
+		/* without a published image wait for the publish lock, held by any process publishing it, and look again */
+		if (segmentStat.st_nlink > 0 && !isImage(segmentStat.st_size))
+		{
+			if (lockByte(fd, PUBLISH_LOCK_BYTE, F_WRLCK, true) != 0 || fstat(fd, &segmentStat) != 0)
+			{
+				break;
+			}
+			if (segmentStat.st_nlink > 0 && !isImage(segmentStat.st_size))
+			{
+				/* this process publishes the reference, keeping the publish lock until it is written */
+				segment->users = 1;
+				openSegments[name] = segment;
+				return true;
+			}
+			lockByte(fd, PUBLISH_LOCK_BYTE, F_UNLCK, false);
+		}
+
+		/* the last user removed the segment while this process waited for the lock, open the next one */
+		if (segmentStat.st_nlink == 0)
+		{
+			::close(fd);
+			continue;
+		}
+
+		void *address = mmap(nullptr, segmentStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (address == MAP_FAILED)
+		{
+			break;
+		}
+		segment->mapping = (char *)address;
+		segment->mappingSize = segmentStat.st_size;
+		segment->published = true;
+		segment->users = 1;
+		openSegments[name] = segment;
+		return true;
+	}
+
+	cerr << "Shared memory segment " << name << " couldn't be opened: " << strerror(errno) << endl;
+	if (fd >= 0)
+	{
+		::close(fd);
+	}
+	segment.reset();
+	return false;
+#endif
+}
+
+/*
+	function to check if the segment holds a complete image, the magic is written last so a segment left behind by a
+	process that died while publishing doesn't
+
+	@param size	=> size of the segment in bytes
+
+	@return true	=> the segment starts with the index magic
+ */
+bool SharedReference::isImage(uint64_t size) const
+{
+#ifndef _WIN32
+	char magic[5];
+	return size > sizeof(magic) && pread(segment->fd, magic, sizeof(magic), 0) == sizeof(magic) && memcmp(magic, "OTIDX", sizeof(magic)) == 0;
+#else
+	return false;
+#endif
+}
+
+/*
+	function to size the segment for an image and map it writable, the caller writes the image and calls publish
+
+	@param size	=> size of the image in bytes
+
+	@return image	=> zero filled writable memory of size bytes, null if the segment couldn't be allocated, in which case
+					   the segment is released for other processes to try
+ */
+char *SharedReference::create(uint64_t size)
+{
+#ifndef _WIN32
+	/* vars */
+	int fd = segment->fd;
+
+	/* allocate every page now, writing to pages shared memory has no room for would crash the process */
+	int error = ftruncate(fd, 0) == 0 && ftruncate(fd, size) == 0 ? 0 : errno;
+#ifdef __linux__
+	if (error == 0)
+	{
+		error = posix_fallocate(fd, 0, size);
+	}
+#endif
+	if (error == 0)
+	{
+		void *address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (address != MAP_FAILED)
+		{
+			segment->mapping = (char *)address;
+			segment->mappingSize = size;
+			return segment->mapping;
+		}
+		error = errno;
+	}
+	cerr << "Shared memory segment " << name << " couldn't be allocated: " << strerror(error) << endl;
+
+	/* drop the unpublished segment, processes and objects of this process waiting for it open a new one */
+	shm_unlink(name.c_str());
+	::close(fd);
+	lock_guard<mutex> guard(segmentsLock);
+	segment->fd = -1;
+	openSegments.erase(name);
+	segmentsChanged.notify_all();
+#endif
+	return nullptr;
+}
+
+/*
+	function to make the image written to the created segment available to other processes and keep using it
+	read-only
+ */
+void SharedReference::publish()
+{
+#ifndef _WIN32
+	uint64_t size = segment->mappingSize;
+	unmap();
+	void *address = mmap(nullptr, size, PROT_READ, MAP_SHARED, segment->fd, 0);
+	if (address == MAP_FAILED)
+	{
+		cerr << "Shared memory segment " << name << " couldn't be mapped: " << strerror(errno) << endl;
+		exit(-1);
+	}
+#ifdef MADV_HUGEPAGE
+	madvise(address, size, MADV_HUGEPAGE);
+#endif
+
+	/*
+		releasing the publish lock lets the processes waiting for the image attach, before taking segmentsLock which an
+		object of this process can hold while it waits for a segment another process publishes
+	*/
+	lockByte(segment->fd, PUBLISH_LOCK_BYTE, F_UNLCK, false);
+	lock_guard<mutex> guard(segmentsLock);
+	segment->mapping = (char *)address;
+	segment->mappingSize = size;
+	segment->published = true;
+	segmentsChanged.notify_all();
+#endif
+}
+
+/*
+	function to remove the segments no process uses, which killed processes left behind, Linux lists them in /dev/shm
+
+	A segment whose user byte can be locked exclusively has no user, whatever reference or OT version it holds. The
+	segments open in this process are skipped, locking them through another descriptor would drop this process's locks
+	on them. Must be called with segmentsLock held.
+ */
+void SharedReference::removeUnusedSegments()
+{
+#ifdef __linux__
+	DIR *directory = opendir("/dev/shm");
+	struct dirent *entry;
+
+	if (directory == nullptr)
+	{
+		return;
+	}
+	while ((entry = readdir(directory)) != nullptr)
+	{
+		string segmentName = string("/") + entry->d_name;
+		if (segmentName.compare(0, 5, "/OT-v") != 0 || openSegments.count(segmentName) > 0)
+		{
+			continue;
+		}
+		int fd = shm_open(segmentName.c_str(), O_RDWR, 0600);
+		if (fd < 0)
+		{
+			continue;
+		}
+		if (lockByte(fd, USER_LOCK_BYTE, F_WRLCK, false) == 0)
+		{
+			shm_unlink(segmentName.c_str());
+		}
+		::close(fd);
+	}
+	closedir(directory);
+#endif
+}
+
+/*
+	function to unmap the segment
+ */
+void SharedReference::unmap()
+{
+#ifndef _WIN32
+	if (segment->mapping != nullptr)
+	{
+		munmap(segment->mapping, segment->mappingSize);
+		segment->mapping = nullptr;
+		segment->mappingSize = 0;
+	}
+#endif
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+/*
+	SharedReference is a named POSIX shared memory segment holding a reference index image that every OT process
+	loading the same CSPR and DB files maps, so a node keeps one copy of the reference however many processes use it
+
+	The segment is named after the sequence length and the fingerprints of the source files. Two byte range locks
+	coordinate the processes. The first process to find the segment empty takes the publish lock and publishes the
+	reference it loaded into it, later processes wait for that lock and map the published image read-only. Every
+	attached process holds a shared user lock for as long as it uses the segment, so the locks count the references: a
+	process that can lock the user byte exclusively when detaching is the last user and removes the segment. Locks are
+	released by the kernel when a process dies, so a crashed process neither keeps the segment alive nor leaves a half
+	written image that is used. A segment whose user byte nobody holds was left behind by a killed process, the next
+	process opening it removes it and publishes a new one, and on Linux opening any segment removes every unused one.
+
+	The locks belong to the process and closing any descriptor of the segment drops all of them, so the objects of one
+	process naming the same segment share one descriptor and mapping, which the last of them to close releases.
+*/
+class SharedReference
+{
+	public:
+		SharedReference() {}
+		SharedReference(const SharedReference &) = delete;
+		SharedReference &operator=(const SharedReference &) = delete;
+
+		/* unmaps the segment and removes it if this was the last process using it */
+		~SharedReference();
+
+		/* function to unmap the segment and remove it if this was the last process using it */
+		void close();
+
+		/* function to open or create the segment of a reference, returns false if shared memory can't be used */
+		bool open(int seqLength, uint64_t csprFingerprint, uint64_t dbFingerprint);
+
+		/* returns true while this process holds the segment open */
+		bool isOpen() const { return segment != nullptr && segment->fd >= 0; }
+
+		/* returns true if the segment holds a published reference image, false if this process has to publish it */
+		bool isPublished() const { return segment != nullptr && segment->published; }
+
+		/* function to size the segment for an image and map it writable, returns null if it can't be */
+		char *create(uint64_t size);
+
+		/* function to make the image written to the created segment available to other processes */
+		void publish();
+
+		/* returns the first byte of the mapped image */
+		const char *data() const { return segment->mapping; }
+
+		/* returns the size of the mapped image in bytes */
+		uint64_t size() const { return segment->mappingSize; }
+
+		/* returns the name of the segment */
+		const string &getName() const { return name; }
+
+	private:
+		/*
+			Segment is a segment opened by this process
+			fd			=> descriptor of the segment, holding this process's locks on it
+			mapping		=> mapped image, read-only once published
+			mappingSize	=> size of the mapping in bytes
+			published	=> true once the segment holds a complete image
+			users		=> objects of this process using the segment
+		*/
+		struct Segment
+		{
+			int fd = -1;
+			char *mapping = nullptr;
+			uint64_t mappingSize = 0;
+			bool published = false;
+			int users = 0;
+		};
+
+		/*
+			name		=> name of the segment
+			segment		=> segment shared with the other objects of this process naming it, null until opened
+		*/
+		string name;
+		shared_ptr<Segment> segment;
+
+		/*
+			Segments of the process
+			openSegments		=> segments open in this process by name
+			segmentsLock		=> guards openSegments and the users and state of its segments
+			segmentsChanged		=> signaled when a segment is published or dropped
+		*/
+		static map<string, shared_ptr<Segment> > openSegments;
+		static mutex segmentsLock;
+		static condition_variable segmentsChanged;
+
+		/* function to remove the segments no process uses, which killed processes left behind */
+		static void removeUnusedSegments();
+
+		/* function to check if the segment holds a complete image */
+		bool isImage(uint64_t size) const;
+
+		/* function to unmap the segment */
+		void unmap();
+};
@@ -0,0 +1,178 @@
+#include "ThreadPool.h"
+#include <chrono>
+
+/* index of the pool worker running on the current thread, -1 outside the pool */
+static thread_local int workerIndex = -1;
+
+/*
+	starts the worker threads
+
+	@param threadCount	=> number of worker threads, at least one is started
+ */
+ThreadPool::ThreadPool(int threadCount)
+{
+	if (threadCount < 1)
+	{
+		threadCount = 1;
+	}
+	for (int i = 0; i < threadCount; i++)
+	{
+		queues.push_back(unique_ptr<WorkerQueue>(new WorkerQueue()));
+	}
+	for (int i = 0; i < threadCount; i++)
+	{
+		workers.push_back(thread(&ThreadPool::workerLoop, this, i));
+	}
+}
+
+/*
+	waits for all submitted tasks and stops the workers
+ */
+ThreadPool::~ThreadPool()
+{
+	wait();
+	{
+		lock_guard<mutex> lock(stateMutex);
+		stopping = true;
+	}
+	taskQueued.notify_all();
+	for (unsigned long i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
+
+/*
+	function to queue a task for execution
+
+	@param task	=> function to run on a worker thread
+ */
+void ThreadPool::submit(function<void()> task)
+{
+	int target = workerIndex;
+	{
+		lock_guard<mutex> lock(stateMutex);
+		if (target < 0)
+		{
+			target = (int)(nextQueue++ % queues.size());
+		}
+		queuedTasks++;
+		unfinishedTasks++;
+	}
+	{
+		lock_guard<mutex> lock(queues[target]->lock);
+		queues[target]->tasks.push_back(move(task));
+	}
+	taskQueued.notify_one();
+}
+
+/*
+	function to block until every submitted task has finished
+ */
+void ThreadPool::wait()
+{
+	unique_lock<mutex> lock(stateMutex);
+	tasksFinished.wait(lock, [this]() { return unfinishedTasks == 0; });
+}
+
+/*
+	function to get the time each worker has spent running tasks, complete for every task finished before wait returned
+
+	@return busy times	=> nanoseconds spent running tasks, by worker index
+ */
+vector<uint64_t> ThreadPool::getBusyTimes() const
+{
+	vector<uint64_t> busyTimes;
+	for (unsigned long i = 0; i < queues.size(); i++)
+	{
+		busyTimes.push_back(queues[i]->busyNanoseconds.load(memory_order_relaxed));
+	}
+	return busyTimes;
+}
+
+/*
+	function to take a task from the worker's own queue or steal one from another
+
+	@param index	=> index of the worker looking for a task
+	@param task		=> filled with the task that was taken
+
+	@return true	=> a task was taken
+	@return false	=> all queues were empty
+ */
+bool ThreadPool::takeTask(int index, function<void()> &task)
+{
+	{
+		lock_guard<mutex> lock(queues[index]->lock);
+		if (!queues[index]->tasks.empty())
+		{
+			task = move(queues[index]->tasks.back());
+			queues[index]->tasks.pop_back();
+			return true;
+		}
+	}
+	for (unsigned long offset = 1; offset < queues.size(); offset++)
+	{
+		WorkerQueue &victim = *queues[(index + offset) % queues.size()];
+		lock_guard<mutex> lock(victim.lock);
+		if (!victim.tasks.empty())
+		{
+			task = move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+	function run by each worker thread
+
+	@param index	=> index of the worker and of its task queue
+ */
+void ThreadPool::workerLoop(int index)
+{
+	workerIndex = index;
+	function<void()> task;
+
+	while (true)
+	{
+		{
+			unique_lock<mutex> lock(stateMutex);
+			taskQueued.wait(lock, [this]() { return queuedTasks > 0 || stopping; });
+			if (queuedTasks == 0 && stopping)
+			{
+				return;
+			}
+			queuedTasks--;
+		}
+
+		/* a task is reserved for this worker, so one of the queues holds it until it is taken */
+		while (!takeTask(index, task))
+		{
+			this_thread::yield();
+		}
+		auto start = chrono::steady_clock::now();
+		task();
+		task = nullptr;
+		queues[index]->busyNanoseconds.fetch_add((uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count(), memory_order_relaxed);
+
+		{
+			lock_guard<mutex> lock(stateMutex);
+			unfinishedTasks--;
+			if (unfinishedTasks == 0)
+			{
+				tasksFinished.notify_all();
+			}
+		}
+	}
+}
+
+/*
+	function to get the index of the worker running the calling thread, tasks use it to pick per worker state
+
+	@return index	=> index of the worker, -1 if the thread is not a pool worker
+ */
+int ThreadPool::getWorkerIndex()
+{
+	return workerIndex;
+}
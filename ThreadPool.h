@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+/*
+	ThreadPool runs submitted tasks on a fixed number of worker threads
+
+	Every worker owns a task queue. Tasks submitted from a worker go to the back of its own queue and are taken back
+	from there, while idle workers steal from the front of the other queues, so a large job split into many tasks
+	spreads across all cores without a single shared queue becoming a bottleneck.
+*/
+class ThreadPool
+{
+	public:
+		/* starts threadCount worker threads */
+		ThreadPool(int threadCount);
+
+		/* waits for all submitted tasks and stops the workers */
+		~ThreadPool();
+
+		/* function to queue a task for execution */
+		void submit(function<void()> task);
+
+		/* function to block until every submitted task has finished */
+		void wait();
+
+		/* returns the number of worker threads */
+		int size() const { return (int)workers.size(); }
+
+		/* returns the time each worker has spent running tasks, in nanoseconds */
+		vector<uint64_t> getBusyTimes() const;
+
+		/* returns the index of the worker running the calling thread, -1 outside of any pool */
+		static int getWorkerIndex();
+
+	private:
+		/*
+			WorkerQueue holds the state of one worker
+			tasks			=> tasks queued on the worker
+			busyNanoseconds	=> time the worker has spent running tasks
+		*/
+		struct WorkerQueue
+		{
+			mutex lock;
+			deque<function<void()> > tasks;
+			atomic<uint64_t> busyNanoseconds{0};
+		};
+
+		/*
+			queues			=> task queue of each worker
+			queuedTasks		=> number of tasks waiting in the queues
+			unfinishedTasks	=> number of tasks submitted but not finished
+			nextQueue		=> queue that receives the next task submitted from outside the pool
+		*/
+		vector<unique_ptr<WorkerQueue> > queues;
+		vector<thread> workers;
+		mutex stateMutex;
+		condition_variable taskQueued;
+		condition_variable tasksFinished;
+		unsigned long queuedTasks = 0;
+		unsigned long unfinishedTasks = 0;
+		unsigned long nextQueue = 0;
+		bool stopping = false;
+
+		/* function run by each worker thread */
+		void workerLoop(int index);
+
+		/* function to take a task from the worker's own queue or steal one from another */
+		bool takeTask(int index, function<void()> &task);
+};
@@ -0,0 +1,311 @@
+#include "Benchmark.h"
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <random>
+
+using std::chrono::steady_clock;
+using std::chrono::duration;
+
+/* number of random mismatch sets the off-target score is timed on */
+static const int SCORE_SETS = 1 << 16;
+
+/* times the off-target score is run over every mismatch set */
+static const int SCORE_ROUNDS = 16;
+
+/*
+	function to run every benchmark and return the JSON report
+
+	@return json	=> report of the data set and every benchmark
+ */
+string Benchmark::run()
+{
+	results.clear();
+	cerr << "Benchmarking parsing" << endl;
+	benchParsing();
+	cerr << "Benchmarking scoring" << endl;
+	benchScoring();
+	cerr << "Benchmarking block scans" << endl;
+	benchBlockScan();
+	for (unsigned long e = 0; e < engines.size(); e++)
+	{
+		cerr << "Benchmarking " << engines[e] << " engine" << endl;
+		benchEndToEnd(engines[e]);
+	}
+	return toJson();
+}
+
+/*
+	function to time a stage iterations times
+
+	@param stage	=> stage to run
+
+	@return seconds	=> time of the fastest run
+ */
+double Benchmark::timeBest(const function<void()> &stage)
+{
+	double best = 0;
+	for (int i = 0; i < max(1, iterations); i++)
+	{
+		auto start = steady_clock::now();
+		stage();
+		double seconds = duration<double>(steady_clock::now() - start).count();
+		best = i == 0 ? seconds : min(best, seconds);
+	}
+	return best;
+}
+
+/*
+	function to get the arguments of a normal OT run on the data set, detailed output of every hit
+
+	@param engine	=> engine of the run
+
+	@return arguments	=> argv of the run, starting with the program name
+ */
+vector<string> Benchmark::getArguments(const string &engine)
+{
+	return { "OT", directory + "/query.txt", endo, directory + "/org.cspr", directory + "/org.db", directory + "/benchmark_output.txt", directory + "/CASPERinfo", to_string(maxMismatches), "0", "TRUE", "FALSE", hsuMatrixName, "--engine=" + engine, "--threads=" + to_string(threadCount) };
+}
+
+/*
+	function to time parsing the CSPR file and the repeats DB into fresh stores
+ */
+void Benchmark::benchParsing()
+{
+	/* vars */
+	FileOperations fileOp;
+	string casperInfoFilePath = directory + "/CASPERinfo", csprFilePath = directory + "/org.cspr", dbFilePath = directory + "/org.db";
+	vector<int> endoData;
+	unsigned long targets = 0;
+
+	fileOp.parseEndoData(casperInfoFilePath, endo, endoData);
+
+	Result cspr = { "parse_cspr", 0, {} };
+	cspr.seconds = timeBest([&]()
+	{
+		PackedSequences seqs;
+		Column<uint8_t> scores;
+		LocationColumn locations;
+		seqs.init(endoData[4]);
+		fileOp.parseCsprFile(csprFilePath, seqs, scores, locations, threadCount, 0, 1);
+		targets = seqs.size();
+	});
+	cspr.metrics.push_back(make_pair("targets", (double)targets));
+	cspr.metrics.push_back(make_pair("targets_per_second", targets / cspr.seconds));
+	results.push_back(cspr);
+
+	Result sql = { "parse_sql", 0, {} };
+	sql.seconds = timeBest([&]()
+	{
+		PackedSequences seqs;
+		Column<uint8_t> scores;
+		LocationColumn locations;
+		Column<RepeatGroup> groups;
+		seqs.init(endoData[4]);
+		fileOp.parseSqlFile(dbFilePath, seqs, scores, locations, groups, threadCount, 0, 1, nullptr);
+		targets = seqs.size();
+	});
+	sql.metrics.push_back(make_pair("repeats", (double)targets));
+	sql.metrics.push_back(make_pair("repeats_per_second", targets / sql.seconds));
+	results.push_back(sql);
+}
+
+/*
+	function to time the off-target score on random sets of one to four mismatches
+ */
+void Benchmark::benchScoring()
+{
+	/* vars */
+	FileOperations fileOp;
+	string casperInfoFilePath = directory + "/CASPERinfo";
+	vector<int> endoData;
+	HsuMatrix hsuMatrix;
+	Score score;
+	mt19937_64 random(1);
+	vector<vector<int> > mismatches(SCORE_SETS);
+	vector<vector<uint8_t> > hsuKeys(SCORE_SETS);
+
+	fileOp.parseCasperInfo(casperInfoFilePath, endo, endoData, hsuMatrixName, hsuMatrix);
+	int seqLength = endoData[4];
+	score.init(hsuMatrix, seqLength);
+	for (int s = 0; s < SCORE_SETS; s++)
+	{
+		int count = 1 + random() % 4;
+		for (int m = 0; m < count; m++)
+		{
+			mismatches[s].push_back(1 + random() % seqLength);
+			hsuKeys[s].push_back((uint8_t)(random() % 16));
+		}
+	}
+
+	/* the table based score over every set, reported per call */
+	Result result = { "score_offtarget", 0, {} };
+	result.seconds = timeBest([&]()
+	{
+		double total = 0;
+		for (int round = 0; round < SCORE_ROUNDS; round++)
+		{
+			for (int s = 0; s < SCORE_SETS; s++)
+			{
+				total += score.offTargetScore(mismatches[s].data(), hsuKeys[s].data(), (int)mismatches[s].size(), 0.5);
+			}
+		}
+		sink += total;
+	});
+	double calls = (double)SCORE_SETS * SCORE_ROUNDS;
+	result.metrics.push_back(make_pair("calls", calls));
+	result.metrics.push_back(make_pair("nanoseconds_per_call", result.seconds * 1e9 / calls));
+	results.push_back(result);
+}
+
+/*
+	function to time the mismatch kernel and the fused block scan of the first query over every unique target
+
+	The block scan is the inner loop of the scan engine: the kernel compares a block of targets, then the mismatches of
+	each target within maxMismatches are extracted (getMismatches) and scored. The difference between the two is the
+	cost of extracting and scoring the mismatches.
+ */
+void Benchmark::benchBlockScan()
+{
+	/* vars */
+	vector<string> arguments = getArguments("scan");
+	vector<char *> argv;
+	OffTarget ot;
+
+	for (unsigned long a = 0; a < arguments.size(); a++)
+	{
+		argv.push_back(&arguments[a][0]);
+	}
+	ot.parseInputArguments((int)argv.size(), argv.data());
+	ot.getAlgorithmData();
+
+	/* the first query, prepared as runBatch prepares it */
+	int seqLength = ot.getSeqLength();
+	OffTarget::QueryData query;
+	ot.setQuerySeq(ot.querySeqs.substr(0, seqLength), query);
+	for (int refScore = 0; refScore < 256; refScore++)
+	{
+		query.ratioTerms[refScore] = pow(double(refScore) / double(ot.queryScores[0]), 2);
+	}
+	query.threshold = 0;
+	query.topK = 0;
+
+	PackedSequences &refSeqs = ot.uniqueSeqs;
+	unsigned long targets = refSeqs.size();
+	int wordsPerSeq = refSeqs.getWordsPerSeq();
+	unsigned long hitCount = 0;
+
+	Result kernel = { string("kernel_compare_") + ot.kernel.getName(), 0, {} };
+	kernel.seconds = timeBest([&]()
+	{
+		uint8_t counts[KERNEL_BLOCK_SIZE];
+		uint64_t masks[KERNEL_BLOCK_SIZE * KERNEL_MAX_WORDS];
+		unsigned long within = 0;
+		for (unsigned long first = 0; first < targets; first += KERNEL_BLOCK_SIZE)
+		{
+			int blockCount = (int)min((unsigned long)KERNEL_BLOCK_SIZE, targets - first);
+			ot.kernel.compare(refSeqs.getSequence(first), query.packedSeq.data(), wordsPerSeq, blockCount, counts, masks);
+			for (int b = 0; b < blockCount; b++)
+			{
+				within += counts[b] <= maxMismatches;
+			}
+		}
+		sink += within;
+	});
+	kernel.metrics.push_back(make_pair("targets_per_second", targets / kernel.seconds));
+	results.push_back(kernel);
+
+	Result block = { "block_scan", 0, {} };
+	block.seconds = timeBest([&]()
+	{
+		HitArena arena;
+		OffTarget::HitBuffer hits;
+		unsigned long indexes[KERNEL_BLOCK_SIZE];
+		hits.arena = &arena;
+		for (unsigned long first = 0; first < targets; first += KERNEL_BLOCK_SIZE)
+		{
+			int blockCount = (int)min((unsigned long)KERNEL_BLOCK_SIZE, targets - first);
+			for (int b = 0; b < blockCount; b++)
+			{
+				indexes[b] = first + b;
+			}
+			(ot.*ot.scoreBlock)(refSeqs.getSequence(first), indexes, blockCount, ot.uniqueScores, true, query, hits);
+		}
+		hitCount = hits.hitCount;
+	});
+	block.metrics.push_back(make_pair("targets_per_second", targets / block.seconds));
+	block.metrics.push_back(make_pair("hits", (double)hitCount));
+	block.metrics.push_back(make_pair("nanoseconds_per_hit", hitCount > 0 ? max(0.0, block.seconds - kernel.seconds) * 1e9 / hitCount : 0.0));
+	results.push_back(block);
+}
+
+/*
+	function to time loading the reference and whole runs of an engine
+
+	@param engine	=> engine of the runs
+ */
+void Benchmark::benchEndToEnd(const string &engine)
+{
+	/* vars */
+	vector<string> arguments = getArguments(engine);
+	vector<char *> argv;
+	unsigned long queries = 0, targets = 0;
+	unique_ptr<OffTarget> ot;
+
+	for (unsigned long a = 0; a < arguments.size(); a++)
+	{
+		argv.push_back(&arguments[a][0]);
+	}
+
+	Result load = { "load_" + engine, 0, {} };
+	load.seconds = timeBest([&]()
+	{
+		ot.reset(new OffTarget());
+		ot->parseInputArguments((int)argv.size(), argv.data());
+		ot->getAlgorithmData();
+	});
+	results.push_back(load);
+	queries = ot->queryScores.size();
+	targets = ot->uniqueSeqs.size() + ot->repeatSeqs.size();
+
+	Result run = { "run_" + engine, 0, {} };
+	run.seconds = timeBest([&]()
+	{
+		ot->run();
+	});
+	run.metrics.push_back(make_pair("queries", (double)queries));
+	run.metrics.push_back(make_pair("targets", (double)targets));
+	run.metrics.push_back(make_pair("queries_per_second", queries / run.seconds));
+	run.metrics.push_back(make_pair("targets_scanned_per_second", (double)queries * targets / run.seconds));
+	results.push_back(run);
+}
+
+/*
+	function to format the results as JSON
+
+	@return json	=> options of the run and one object per benchmark
+ */
+string Benchmark::toJson()
+{
+	ostringstream json;
+	json << setprecision(9);
+	json << "{\n";
+	json << "  \"directory\": \"" << directory << "\",\n";
+	json << "  \"endo\": \"" << endo << "\",\n";
+	json << "  \"max_mismatches\": " << maxMismatches << ",\n";
+	json << "  \"threads\": " << threadCount << ",\n";
+	json << "  \"iterations\": " << iterations << ",\n";
+	json << "  \"benchmarks\": [\n";
+	for (unsigned long r = 0; r < results.size(); r++)
+	{
+		json << "    {\"name\": \"" << results[r].name << "\", \"seconds\": " << results[r].seconds;
+		for (unsigned long m = 0; m < results[r].metrics.size(); m++)
+		{
+			json << ", \"" << results[r].metrics[m].first << "\": " << results[r].metrics[m].second;
+		}
+		json << "}" << (r + 1 < results.size() ? "," : "") << "\n";
+	}
+	json << "  ]\n";
+	json << "}\n";
+	return json.str();
+}
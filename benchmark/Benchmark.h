@@ -0,0 +1,81 @@
+#pragma once
+#include "../OffTarget.h"
+#include <string>
+#include <vector>
+#include <functional>
+#include <utility>
+
+using namespace std;
+
+/*
+	Benchmark times the stages of OT on a data set written by SyntheticData, or any data set laid out the same way, and
+	reports them as JSON
+
+	Micro-benchmarks cover parsing the CSPR file and the repeats DB, the table based off-target score, the mismatch
+	kernel and the fused block scan that extracts the mismatches of every target within maxMismatches and scores it.
+	End-to-end runs report queries and reference targets scanned per second for each engine. Every stage is run
+	iterations times and the fastest run is reported, which is the least noisy estimate on a shared machine.
+*/
+class Benchmark
+{
+	public:
+		/*
+			Benchmark options
+			directory		=> data set directory holding CASPERinfo, org.cspr, org.db and query.txt
+			endo			=> endonuclease of the data set
+			hsuMatrixName	=> HSU matrix of CASPERinfo used for scoring
+			maxMismatches	=> max mismatches of the end-to-end runs and block scans
+			engines			=> engines run end to end
+			threadCount		=> threads of the parsers and end-to-end runs
+			iterations		=> runs of each stage, the fastest is reported
+		*/
+		string directory;
+		string endo = "spCas9";
+		string hsuMatrixName = "MATRIX:SYNTHETIC-spCas9";
+		int maxMismatches = 4;
+		vector<string> engines = {"scan", "seed"};
+		int threadCount = max(1, (int)thread::hardware_concurrency());
+		int iterations = 3;
+
+		/* function to run every benchmark and return the JSON report */
+		string run();
+
+	private:
+		/*
+			Result of a benchmark
+			name	=> name of the stage
+			seconds	=> time of the fastest run
+			metrics	=> derived rates and counts, by name
+		*/
+		struct Result
+		{
+			string name;
+			double seconds;
+			vector<pair<string, double> > metrics;
+		};
+		vector<Result> results;
+
+		/* sink for computed values, so the timed loops can't be optimized away */
+		double sink = 0;
+
+		/* function to time a stage iterations times, returns the fastest run in seconds */
+		double timeBest(const function<void()> &stage);
+
+		/* function to get the arguments of a normal OT run on the data set */
+		vector<string> getArguments(const string &engine);
+
+		/* function to time parsing the CSPR file and the repeats DB */
+		void benchParsing();
+
+		/* function to time the off-target score on random mismatch sets */
+		void benchScoring();
+
+		/* function to time the mismatch kernel and the fused block scan over the unique targets */
+		void benchBlockScan();
+
+		/* function to time whole runs of an engine */
+		void benchEndToEnd(const string &engine);
+
+		/* function to format the results as JSON */
+		string toJson();
+};
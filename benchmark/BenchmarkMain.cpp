@@ -0,0 +1,231 @@
+#include "Benchmark.h"
+#include "SyntheticData.h"
+#include "SelfCheck.h"
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+/*
+	function to split a comma separated list
+
+	@param list	=> comma separated values
+
+	@return values	=> values of the list, in order
+ */
+static vector<string> splitList(const string &list)
+{
+	vector<string> values;
+	stringstream stream(list);
+	string value;
+	while (getline(stream, value, ','))
+	{
+		values.push_back(value);
+	}
+	return values;
+}
+
+/*
+	function for parsing one option of generate mode given as --name=value
+
+	@param arg		=> argument to parse
+	@param data		=> generator the option is stored in
+
+	@return true	=> the option was recognized and stored
+	@return false	=> unknown option or invalid value
+ */
+static bool parseGenerateOption(const string &arg, SyntheticData &data)
+{
+	size_t split = arg.find('=');
+	string name = arg.substr(0, split);
+	string value = split == string::npos ? "" : arg.substr(split + 1);
+
+	if (name == "--endo" && (value == "spCas9" || value == "asCas12"))
+	{
+		data.endo = value;
+	}
+	else if (name == "--targets" && atol(value.c_str()) > 0)
+	{
+		data.targets = (unsigned long)atol(value.c_str());
+	}
+	else if (name == "--chromosomes" && atoi(value.c_str()) > 0)
+	{
+		data.chromosomes = atoi(value.c_str());
+	}
+	else if (name == "--repeat-rows" && value != "" && atol(value.c_str()) >= 0)
+	{
+		data.repeatRows = (unsigned long)atol(value.c_str());
+	}
+	else if (name == "--repeats-per-row" && atoi(value.c_str()) >= 2)
+	{
+		data.repeatsPerRow = atoi(value.c_str());
+	}
+	else if (name == "--queries" && atol(value.c_str()) > 0)
+	{
+		data.queries = (unsigned long)atol(value.c_str());
+	}
+	else if (name == "--near-fraction" && value != "" && atof(value.c_str()) >= 0 && atof(value.c_str()) <= 1)
+	{
+		data.nearFraction = atof(value.c_str());
+	}
+	else if (name == "--mismatch-weights" && value != "")
+	{
+		data.mismatchWeights.clear();
+		vector<string> weights = splitList(value);
+		for (unsigned long w = 0; w < weights.size(); w++)
+		{
+			data.mismatchWeights.push_back(max(0.0, atof(weights[w].c_str())));
+		}
+	}
+	else if (name == "--seed" && value != "")
+	{
+		data.seed = strtoull(value.c_str(), nullptr, 10);
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+/*
+	function for parsing one option of run mode given as --name=value
+
+	@param arg			=> argument to parse
+	@param benchmark	=> benchmark the option is stored in
+	@param jsonFilePath	=> set to the file the report is written to
+
+	@return true	=> the option was recognized and stored
+	@return false	=> unknown option or invalid value
+ */
+static bool parseRunOption(const string &arg, Benchmark &benchmark, string &jsonFilePath)
+{
+	size_t split = arg.find('=');
+	string name = arg.substr(0, split);
+	string value = split == string::npos ? "" : arg.substr(split + 1);
+
+	if (name == "--endo" && (value == "spCas9" || value == "asCas12"))
+	{
+		benchmark.endo = value;
+		benchmark.hsuMatrixName = "MATRIX:SYNTHETIC-" + value;
+	}
+	else if (name == "--matrix" && value != "")
+	{
+		benchmark.hsuMatrixName = value;
+	}
+	else if (name == "--max-mismatches" && value != "" && atoi(value.c_str()) >= 0)
+	{
+		benchmark.maxMismatches = atoi(value.c_str());
+	}
+	else if (name == "--engines" && value != "")
+	{
+		benchmark.engines = splitList(value);
+		for (unsigned long e = 0; e < benchmark.engines.size(); e++)
+		{
+			if (benchmark.engines[e] != "auto" && benchmark.engines[e] != "scan" && benchmark.engines[e] != "seed" && benchmark.engines[e] != "fm")
+			{
+				return false;
+			}
+		}
+	}
+	else if (name == "--threads" && atoi(value.c_str()) > 0)
+	{
+		benchmark.threadCount = atoi(value.c_str());
+	}
+	else if (name == "--iterations" && atoi(value.c_str()) > 0)
+	{
+		benchmark.iterations = atoi(value.c_str());
+	}
+	else if (name == "--json" && value != "")
+	{
+		jsonFilePath = value;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	string mode = argc > 1 ? argv[1] : "";
+
+	/* check mode: run the consistency checks that don't need a data set */
+	if (mode == "check")
+	{
+		SelfCheck check;
+		for (int i = 2; i < argc; i++)
+		{
+			string arg = argv[i];
+			if (arg.compare(0, 7, "--seed=") != 0 || arg.size() == 7)
+			{
+				cerr << "Invalid option: " << arg << endl;
+				exit(-1);
+			}
+			check.seed = strtoull(arg.c_str() + 7, nullptr, 10);
+		}
+		if (!check.run())
+		{
+			exit(-1);
+		}
+		return 0;
+	}
+
+	if ((mode != "generate" && mode != "run") || argc < 3)
+	{
+		cerr << "Usage: OT_bench generate directory [--endo=spCas9|asCas12] [--targets=N] [--chromosomes=N] [--repeat-rows=N] [--repeats-per-row=N] [--queries=N] [--near-fraction=F] [--mismatch-weights=W0,W1,...] [--seed=N]" << endl;
+		cerr << "       OT_bench run directory [--endo=spCas9|asCas12] [--matrix=name] [--max-mismatches=N] [--engines=scan,seed,fm] [--threads=N] [--iterations=N] [--json=path]" << endl;
+		cerr << "       OT_bench check [--seed=N]" << endl;
+		exit(-1);
+	}
+	string directory = argv[2];
+
+	/* generate mode: write a synthetic data set */
+	if (mode == "generate")
+	{
+		SyntheticData data;
+		for (int i = 3; i < argc; i++)
+		{
+			if (!parseGenerateOption(argv[i], data))
+			{
+				cerr << "Invalid option: " << argv[i] << endl;
+				exit(-1);
+			}
+		}
+		cerr << "Writing synthetic data set to " << directory << endl;
+		if (!data.write(directory))
+		{
+			exit(-1);
+		}
+		return 0;
+	}
+
+	/* run mode: time every stage on a data set and print or write the JSON report */
+	Benchmark benchmark;
+	string jsonFilePath;
+	benchmark.directory = directory;
+	for (int i = 3; i < argc; i++)
+	{
+		if (!parseRunOption(argv[i], benchmark, jsonFilePath))
+		{
+			cerr << "Invalid option: " << argv[i] << endl;
+			exit(-1);
+		}
+	}
+	string json = benchmark.run();
+	if (jsonFilePath == "")
+	{
+		cout << json;
+		return 0;
+	}
+	ofstream jsonFile(jsonFilePath);
+	jsonFile << json;
+	jsonFile.close();
+	if (jsonFile.fail())
+	{
+		cerr << "JSON report " << jsonFilePath << " couldn't be written." << endl;
+		exit(-1);
+	}
+	return 0;
+}
@@ -0,0 +1,253 @@
+#include "SelfCheck.h"
+#include <iostream>
+
+/* sequence lengths the kernels are checked on, from the endonuclease lengths up to KERNEL_MAX_WORDS full words */
+static const int CHECK_LENGTHS[] = {20, 24, 31, 32, 33, 63, 64, 65, 96, 100, 127, 128};
+
+/* random blocks checked per sequence length and block size */
+static const int CHECK_ROUNDS = 8;
+
+/* targets and chromosomes stored by the location check */
+static const unsigned long CHECK_TARGETS = 100000;
+static const int CHECK_CHROMS = 4;
+
+/* length of the chromosomes of the location check, above 2^32 bases so they need more than one range */
+static const long long CHECK_CHROM_LENGTH = 5000000000LL;
+
+/*
+	function to run every check
+
+	@return true	=> every check passed
+	@return false	=> a check failed, the difference is written to cerr
+ */
+bool SelfCheck::run()
+{
+	random.seed(seed);
+	return checkKernels() && checkLocations();
+}
+
+/*
+	function to compare every supported mismatch kernel against the scalar kernel and a base by base count
+
+	Each block holds one query and targets that are identical to it, unrelated random sequences, copies with a few
+	random mismatches, copies mismatched at the edge bases and complements mismatched at every base.
+
+	@return true	=> every kernel gave the same counts and masks on every block
+	@return false	=> a kernel differed, the block is written to cerr
+ */
+bool SelfCheck::checkKernels()
+{
+	/* vars */
+	vector<string> names = MismatchKernel::getSupportedNames();
+	vector<MismatchKernel> kernels(names.size());
+	unsigned long blocks = 0;
+
+	for (unsigned long k = 0; k < names.size(); k++)
+	{
+		kernels[k].select(names[k]);
+	}
+	for (int seqLength : CHECK_LENGTHS)
+	{
+		int wordsPerSeq = PackedSequences::wordsFor(seqLength);
+		vector<int> edges = {0, seqLength - 1};
+		for (int boundary = 32; boundary < seqLength; boundary += 32)
+		{
+			edges.push_back(seqLength - boundary - 1);
+			edges.push_back(seqLength - boundary);
+		}
+
+		for (int targetCount = 1; targetCount <= KERNEL_BLOCK_SIZE; targetCount++)
+		{
+			for (int round = 0; round < CHECK_ROUNDS; round++)
+			{
+				/* build the block */
+				string query = randomSequence(seqLength);
+				vector<string> targets(targetCount, query);
+				vector<uint64_t> queryWords(wordsPerSeq), refWords(targetCount * wordsPerSeq);
+				for (int t = 0; t < targetCount; t++)
+				{
+					switch (random() % 5)
+					{
+						case 0:
+							break;
+						case 1:
+							targets[t] = randomSequence(seqLength);
+							break;
+						case 2:
+							for (int m = random() % 6; m > 0; m--)
+							{
+								mutate(targets[t], random() % seqLength);
+							}
+							break;
+						case 3:
+							for (int edge : edges)
+							{
+								if (random() % 2 == 0)
+								{
+									mutate(targets[t], edge);
+								}
+							}
+							break;
+						default:
+							for (char &base : targets[t])
+							{
+								base = base == 'A' ? 'T' : base == 'C' ? 'G' : base == 'G' ? 'C' : 'A';
+							}
+					}
+					PackedSequences::pack(targets[t], seqLength, &refWords[t * wordsPerSeq]);
+				}
+				PackedSequences::pack(query, seqLength, queryWords.data());
+
+				/* the base by base count every kernel has to match */
+				vector<uint8_t> expected(targetCount);
+				for (int t = 0; t < targetCount; t++)
+				{
+					for (int j = 0; j < seqLength; j++)
+					{
+						expected[t] += targets[t][j] != query[j];
+					}
+				}
+
+				/* compare each kernel against the count and the masks of the scalar kernel */
+				uint8_t scalarCounts[KERNEL_BLOCK_SIZE];
+				uint64_t scalarMasks[KERNEL_BLOCK_SIZE * KERNEL_MAX_WORDS];
+				kernels[0].compare(refWords.data(), queryWords.data(), wordsPerSeq, targetCount, scalarCounts, scalarMasks);
+				for (unsigned long k = 0; k < kernels.size(); k++)
+				{
+					uint8_t counts[KERNEL_BLOCK_SIZE];
+					uint64_t masks[KERNEL_BLOCK_SIZE * KERNEL_MAX_WORDS];
+					kernels[k].compare(refWords.data(), queryWords.data(), wordsPerSeq, targetCount, counts, masks);
+					for (int t = 0; t < targetCount; t++)
+					{
+						bool masksMatch = equal(masks + t * wordsPerSeq, masks + (t + 1) * wordsPerSeq, scalarMasks + t * wordsPerSeq);
+						if (counts[t] != expected[t] || !masksMatch)
+						{
+							cerr << "Kernel " << kernels[k].getName() << " differs on target " << t << " of a block of " << targetCount << ", length " << seqLength << endl;
+							cerr << "\tquery  " << query << endl << "\ttarget " << targets[t] << endl;
+							cerr << "\tmismatches " << (int)counts[t] << ", expected " << (int)expected[t] << (masksMatch ? "" : ", masks differ from scalar") << endl;
+							return false;
+						}
+					}
+				}
+				blocks++;
+			}
+		}
+	}
+
+	cerr << "Kernels";
+	for (unsigned long k = 0; k < kernels.size(); k++)
+	{
+		cerr << " " << kernels[k].getName();
+	}
+	cerr << " agree on " << blocks << " blocks." << endl;
+	return true;
+}
+
+/*
+	function to check that location columns store long chromosomes in few ranges
+
+	A column with chromosome runs gets CHECK_CHROMS chromosomes of ascending locations on random strands, as a CSPR file
+	lists them, and a column keeping one chromosome per target gets random locations beyond 2^31 of random chromosomes,
+	as the repeats DB lists them. Each column is built by push_back and by encoding chunks the way the parallel CSPR
+	parser does, and every location and chromosome has to decode unchanged.
+
+	@return true	=> every location decoded unchanged and the range tables stayed small
+	@return false	=> a location, chromosome or range count differed, written to cerr
+ */
+bool SelfCheck::checkLocations()
+{
+	for (int runs = 1; runs >= 0; runs--)
+	{
+		/* vars */
+		vector<int> chroms(CHECK_TARGETS);
+		vector<long long> locations(CHECK_TARGETS);
+		LocationColumn appended, chunked;
+		unsigned long maxRanges = runs ? CHECK_CHROMS * (CHECK_CHROM_LENGTH / (1LL << 31) + 1) : 1;
+
+		for (unsigned long t = 0; t < CHECK_TARGETS; t++)
+		{
+			if (runs)
+			{
+				chroms[t] = 1 + (int)(t * CHECK_CHROMS / CHECK_TARGETS);
+				locations[t] = (long long)((t * CHECK_CHROMS % CHECK_TARGETS) * (CHECK_CHROM_LENGTH / CHECK_TARGETS));
+			}
+			else
+			{
+				chroms[t] = 1 + random() % CHECK_CHROMS;
+				locations[t] = (1LL << 31) + (long long)(random() % 1000000000);
+			}
+			if (random() % 2 == 0)
+			{
+				locations[t] = -locations[t];
+			}
+		}
+
+		appended.init(runs);
+		chunked.init(runs);
+		chunked.resize(CHECK_TARGETS);
+		for (unsigned long t = 0; t < CHECK_TARGETS; t++)
+		{
+			appended.push_back(chroms[t], locations[t]);
+		}
+		for (unsigned long first = 0; first < CHECK_TARGETS; first += CHECK_TARGETS / 7)
+		{
+			vector<LocationRange> chunkRanges;
+			for (unsigned long t = first; t < min(CHECK_TARGETS, first + CHECK_TARGETS / 7); t++)
+			{
+				chunked.setOffset(t, LocationColumn::encode(t, runs ? chroms[t] : 0, locations[t], chunkRanges));
+			}
+			chunked.appendRanges(chunkRanges);
+		}
+
+		LocationColumn *columns[2] = { &appended, &chunked };
+		for (LocationColumn *column : columns)
+		{
+			if (column->getRanges().size() > maxRanges)
+			{
+				cerr << "Location column " << (runs ? "with" : "without") << " chromosome runs holds " << column->getRanges().size() << " ranges, expected at most " << maxRanges << endl;
+				return false;
+			}
+			/* the chunked column without chromosome runs only holds locations, its chromosomes aren't checked */
+			for (unsigned long t = 0; t < CHECK_TARGETS; t++)
+			{
+				if (column->getLocation(t) != locations[t] || ((runs || column == &appended) && column->getChrom(t) != chroms[t]))
+				{
+					cerr << "Location column " << (runs ? "with" : "without") << " chromosome runs decodes target " << t << " as " << column->getChrom(t) << ":" << column->getLocation(t) << ", expected " << chroms[t] << ":" << locations[t] << endl;
+					return false;
+				}
+			}
+		}
+	}
+
+	cerr << "Location columns decode " << 2 * CHECK_TARGETS << " locations of chromosomes longer than 2^31 from few ranges." << endl;
+	return true;
+}
+
+/*
+	function to get a random sequence
+
+	@param seqLength	=> number of bases
+
+	@return seq	=> random sequence of A, C, G and T
+ */
+string SelfCheck::randomSequence(int seqLength)
+{
+	string seq(seqLength, 'A');
+	for (char &base : seq)
+	{
+		base = "ACGT"[random() % 4];
+	}
+	return seq;
+}
+
+/*
+	function to change a base of a sequence to one of the three other bases
+
+	@param seq		=> sequence to change
+	@param position	=> index of the base
+ */
+void SelfCheck::mutate(string &seq, int position)
+{
+	static const string bases = "ACGT";
+	seq[position] = bases[(bases.find(seq[position]) + 1 + random() % 3) % 4];
+}
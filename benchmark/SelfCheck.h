@@ -0,0 +1,45 @@
+#pragma once
+#include "../MismatchKernel.h"
+#include "../LocationColumn.h"
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdint>
+
+using namespace std;
+
+/*
+	SelfCheck runs consistency checks of OT components that don't need a data set
+
+	The kernel check compares every mismatch kernel the running CPU supports against the scalar kernel and a base by
+	base count, on random blocks and on edge cases: lengths 20 and 24 of the endonucleases, sequences ending exactly on
+	or just past a word boundary, partially filled tail words, mismatches at the first and last base and at the bases
+	either side of a word boundary, and blocks of every size up to KERNEL_BLOCK_SIZE.
+
+	The location check stores locations of chromosomes longer than 2^31 on both strands in location columns, appended one by one and
+	encoded in parallel chunks, and checks they decode unchanged while the range table stays a few ranges per window.
+*/
+class SelfCheck
+{
+	public:
+		/* seed of the random generator */
+		uint64_t seed = 1;
+
+		/* function to run every check, returns false if any of them failed */
+		bool run();
+
+	private:
+		mt19937_64 random;
+
+		/* function to check the mismatch kernels against each other, returns false on the first difference */
+		bool checkKernels();
+
+		/* function to check that location columns store long chromosomes in few ranges, returns false on a failure */
+		bool checkLocations();
+
+		/* function to get a random sequence of a length */
+		string randomSequence(int seqLength);
+
+		/* function to change a base of a sequence to a different random base */
+		void mutate(string &seq, int position);
+};
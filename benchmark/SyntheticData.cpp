@@ -0,0 +1,257 @@
+#include "SyntheticData.h"
+#include "sqlite3.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+/*
+	function to write the data set to a directory: CASPERinfo, org.cspr, org.db and query.txt
+
+	@param directory	=> existing directory the files are written to
+
+	@return true	=> every file was written
+	@return false	=> unknown endonuclease or a file couldn't be written, a message is printed
+ */
+bool SyntheticData::write(const string &directory)
+{
+	if (!setEndo())
+	{
+		cerr << "Unknown endonuclease " << endo << ", use spCas9 or asCas12." << endl;
+		return false;
+	}
+	random.seed(seed);
+
+	/* queries first, the planted targets are drawn near them */
+	querySeqs.clear();
+	for (unsigned long q = 0; q < queries; q++)
+	{
+		querySeqs.push_back(randomSequence(getSeqLength()));
+	}
+	return writeCasperInfo(directory + "/CASPERinfo") && writeCspr(directory + "/org.cspr") && writeRepeats(directory + "/org.db") && writeQueries(directory + "/query.txt");
+}
+
+/*
+	function to set the geometry of the endonuclease
+
+	@return true	=> the endonuclease is known
+ */
+bool SyntheticData::setEndo()
+{
+	if (endo == "spCas9")
+	{
+		fiveLength = 0;
+		seedLength = 16;
+		threeLength = 4;
+		pam = "NGG";
+		return true;
+	}
+	if (endo == "asCas12")
+	{
+		fiveLength = 4;
+		seedLength = 16;
+		threeLength = 4;
+		pam = "TTTV";
+		return true;
+	}
+	return false;
+}
+
+/*
+	function to draw a random sequence
+
+	@param length	=> number of bases
+
+	@return seq	=> random bases
+ */
+string SyntheticData::randomSequence(int length)
+{
+	string seq(length, 'A');
+	for (int i = 0; i < length; i++)
+	{
+		seq[i] = "ACGT"[random() & 3];
+	}
+	return seq;
+}
+
+/*
+	function to draw a target
+
+	@param near	=> true to plant the target near a random query, with a number of mismatches drawn from mismatchWeights
+
+	@return seq	=> target sequence
+ */
+string SyntheticData::drawTarget(bool near)
+{
+	if (!near || querySeqs.empty())
+	{
+		return randomSequence(getSeqLength());
+	}
+	string seq = querySeqs[random() % querySeqs.size()];
+	discrete_distribution<int> mismatchCount(mismatchWeights.begin(), mismatchWeights.end());
+	int mismatches = min(mismatchCount(random), getSeqLength());
+
+	/* distinct positions, each changed to another base */
+	vector<int> positions(getSeqLength());
+	for (int i = 0; i < getSeqLength(); i++)
+	{
+		positions[i] = i;
+	}
+	for (int m = 0; m < mismatches; m++)
+	{
+		swap(positions[m], positions[m + random() % (getSeqLength() - m)]);
+		int code = (int)string("ACGT").find(seq[positions[m]]);
+		seq[positions[m]] = "ACGT"[(code + 1 + random() % 3) & 3];
+	}
+	return seq;
+}
+
+/*
+	function to write CASPERinfo with both endonucleases and the HSU matrix
+
+	@param filePath	=> file path of CASPERinfo
+
+	@return true	=> the file was written
+ */
+bool SyntheticData::writeCasperInfo(const string &filePath)
+{
+	ofstream file(filePath);
+	uniform_real_distribution<double> hsuValue(0.0, 1.5);
+
+	file << "ENDONUCLEASES\n";
+	file << "spCas9;NGG;4;16;0;3\n";
+	file << "asCas12;TTTV;4;16;4;5\n";
+	file << "-----\n";
+	file << getHsuMatrixName() << "\n";
+	file << fixed << setprecision(6);
+	for (int row = 0; row < 12; row++)
+	{
+		for (int column = 0; column < getSeqLength(); column++)
+		{
+			file << (column > 0 ? " " : "") << hsuValue(random);
+		}
+		file << "\n";
+	}
+	file << "-----\n";
+	file.close();
+	if (file.fail())
+	{
+		cerr << "CASPERinfo " << filePath << " couldn't be written." << endl;
+		return false;
+	}
+	return true;
+}
+
+/*
+	function to write the CSPR file of unique targets, spread evenly over the chromosomes
+
+	@param filePath	=> file path of the CSPR file
+
+	@return true	=> the file was written
+ */
+bool SyntheticData::writeCspr(const string &filePath)
+{
+	ofstream file(filePath);
+	bernoulli_distribution near(nearFraction);
+
+	file << "GENOME: synthetic\nMISC: seed " << seed << "\nStats: " << targets << " targets\n";
+	for (int chrom = 0; chrom < chromosomes; chrom++)
+	{
+		unsigned long first = targets * chrom / chromosomes, last = targets * (chrom + 1) / chromosomes;
+		long long location = 0;
+		file << ">chr" << chrom + 1 << " (synthetic)\n";
+		for (unsigned long t = first; t < last; t++)
+		{
+			location += 1 + random() % 50;
+			file << ((random() & 1) ? location : -location) << "," << drawTarget(near(random)) << "," << pam << "," << 1 + random() % 100 << "\n";
+		}
+	}
+	file.close();
+	if (file.fail())
+	{
+		cerr << "CSPR file " << filePath << " couldn't be written." << endl;
+		return false;
+	}
+	return true;
+}
+
+/*
+	function to write the repeats DB, each row holds a seed and the lists of the repeats sharing it
+
+	@param filePath	=> file path of the DB file, replaced if it exists
+
+	@return true	=> the file was written
+ */
+bool SyntheticData::writeRepeats(const string &filePath)
+{
+	sqlite3 *db;
+	sqlite3_stmt *insert;
+	bernoulli_distribution near(nearFraction);
+	uniform_int_distribution<int> repeatCount(2, max(2, 2 * repeatsPerRow - 2));
+
+	remove(filePath.c_str());
+	if (sqlite3_open(filePath.c_str(), &db) != SQLITE_OK || sqlite3_exec(db, "CREATE TABLE repeats (seed TEXT PRIMARY KEY, chromosome TEXT, location TEXT, three TEXT, five TEXT, score TEXT); BEGIN;", nullptr, nullptr, nullptr) != SQLITE_OK || sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO repeats VALUES (?, ?, ?, ?, ?, ?);", -1, &insert, nullptr) != SQLITE_OK)
+	{
+		cerr << "Repeats DB " << filePath << " couldn't be written: " << sqlite3_errmsg(db) << endl;
+		sqlite3_close(db);
+		return false;
+	}
+
+	for (unsigned long row = 0; row < repeatRows; row++)
+	{
+		/* the first repeat of a row gives its seed, the others share it with their own extensions */
+		string target = drawTarget(near(random));
+		string seedSeq = target.substr(fiveLength, seedLength);
+		ostringstream chromosome, location, three, five, score;
+		int count = repeatCount(random);
+		for (int r = 0; r < count; r++)
+		{
+			string seq = r == 0 ? target : randomSequence(getSeqLength());
+			const char *separator = r > 0 ? "," : "";
+			chromosome << separator << 1 + random() % chromosomes;
+			location << separator << (long long)(random() % 2000000) - 1000000;
+			three << separator << seq.substr(fiveLength + seedLength);
+			five << separator << seq.substr(0, fiveLength);
+			score << separator << 1 + random() % 100;
+		}
+
+		string columns[6] = { seedSeq, chromosome.str(), location.str(), three.str(), five.str(), score.str() };
+		for (int c = 0; c < 6; c++)
+		{
+			sqlite3_bind_text(insert, c + 1, columns[c].c_str(), (int)columns[c].size(), SQLITE_TRANSIENT);
+		}
+		sqlite3_step(insert);
+		sqlite3_reset(insert);
+	}
+	sqlite3_finalize(insert);
+	bool written = sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+	sqlite3_close(db);
+	if (!written)
+	{
+		cerr << "Repeats DB " << filePath << " couldn't be written." << endl;
+	}
+	return written;
+}
+
+/*
+	function to write the query file
+
+	@param filePath	=> file path of the query file
+
+	@return true	=> the file was written
+ */
+bool SyntheticData::writeQueries(const string &filePath)
+{
+	ofstream file(filePath);
+	for (unsigned long q = 0; q < querySeqs.size(); q++)
+	{
+		file << "chr1;" << querySeqs[q] << ";" << pam << ";" << 20 + random() % 81 << "\n";
+	}
+	file.close();
+	if (file.fail())
+	{
+		cerr << "Query file " << filePath << " couldn't be written." << endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdint>
+
+using namespace std;
+
+/*
+	SyntheticData writes a synthetic organism in the formats OT reads: a CASPERinfo file holding the endonucleases and
+	an HSU matrix, a CSPR file of unique targets, a repeats DB and a query file
+
+	Targets are random sequences except for a fraction planted near the queries, each a query with a number of
+	mismatches drawn from mismatchWeights, so the share of targets the scans have to score can be set to match a real
+	workload. The output only depends on the options, so a data set can be recreated anywhere from its options.
+*/
+class SyntheticData
+{
+	public:
+		/*
+			Generator options
+			endo			=> spCas9 (20 bases, 3' PAM) or asCas12 (24 bases, 5' PAM)
+			targets			=> number of unique targets in the CSPR file
+			chromosomes		=> number of chromosomes the unique targets are spread over
+			repeatRows		=> number of rows of the repeats DB, one seed each
+			repeatsPerRow	=> average number of repeats sharing the seed of a row, at least 2
+			queries			=> number of query sequences
+			nearFraction	=> fraction of targets and repeat rows planted near a query
+			mismatchWeights	=> relative weight of planting a target with 0, 1, 2, ... mismatches against its query
+			seed			=> seed of the random generator
+		*/
+		string endo = "spCas9";
+		unsigned long targets = 1000000;
+		int chromosomes = 10;
+		unsigned long repeatRows = 20000;
+		int repeatsPerRow = 4;
+		unsigned long queries = 100;
+		double nearFraction = 0.05;
+		vector<double> mismatchWeights = {1, 2, 4, 8, 8, 4};
+		uint64_t seed = 1;
+
+		/* function to write the data set to a directory, returns false if a file couldn't be written */
+		bool write(const string &directory);
+
+		/* returns the sequence length of the endonuclease */
+		int getSeqLength() const { return fiveLength + seedLength + threeLength; }
+
+		/* returns the name of the HSU matrix written to CASPERinfo */
+		string getHsuMatrixName() const { return "MATRIX:SYNTHETIC-" + endo; }
+
+	private:
+		/*
+			Endonuclease geometry definitions
+			fiveLength/seedLength/threeLength	=> lengths of the 5' extension, seed and 3' extension of a target
+			pam									=> PAM written with every target
+		*/
+		int fiveLength = 0, seedLength = 16, threeLength = 4;
+		string pam = "NGG";
+
+		mt19937_64 random;
+		vector<string> querySeqs;
+
+		/* function to set the geometry of the endonuclease, returns false for an unknown one */
+		bool setEndo();
+
+		/* function to draw a random sequence */
+		string randomSequence(int length);
+
+		/* function to draw a target, planted near a random query or random */
+		string drawTarget(bool near);
+
+		/* function to write CASPERinfo with both endonucleases and the HSU matrix */
+		bool writeCasperInfo(const string &filePath);
+
+		/* function to write the CSPR file of unique targets */
+		bool writeCspr(const string &filePath);
+
+		/* function to write the repeats DB */
+		bool writeRepeats(const string &filePath);
+
+		/* function to write the query file */
+		bool writeQueries(const string &filePath);
+};
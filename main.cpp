@@ -1,4 +1,5 @@
 #include "OffTarget.h"
+#include "Server.h"
 
 #include <chrono>
 #include <fstream>
@@ -18,17 +19,59 @@ int main(int argc, char *argv[])
 	/* create OffTarget object */
 	OffTarget OT;
 
+	/* index mode: write the reference index of a CSPR file and its repeats DB */
+	if (argc > 1 && string(argv[1]) == "index")
+	{
+		cout << "Building reference index" << endl;
+		OT.parseIndexArguments(argc, argv);
+		OT.buildIndex();
+		return 0;
+	}
+
+	/* server mode: keep organisms loaded and score query batches sent over stdin/stdout or a Unix domain socket */
+	if (argc > 1 && string(argv[1]) == "serve")
+	{
+		if (argc != 3 && argc != 4)
+		{
+			cerr << "Usage: OT serve organisms_file_path [socket_path]" << endl;
+			exit(-1);
+		}
+		Server server;
+		string organismsFilePath = argv[2];
+		server.loadOrganisms(organismsFilePath);
+		if (argc == 4)
+		{
+			string socketPath = argv[3];
+			server.serveSocket(socketPath);
+		}
+		else
+		{
+			cerr << "Serving requests on stdin" << endl;
+			server.serveStdio();
+		}
+		return 0;
+	}
+
 	/* store input arguments */
 	cout << "Parsing Input Arguments" << endl;
 	OT.parseInputArguments(argc, argv);
 
-	/* parse data needed for algorithm */
-	cout << "Loading data for algorithm" << endl;
-	OT.getAlgorithmData();
+	if (OT.getShardCount() > 1)
+	{
+		/* shard mode: worker processes load and scan parts of the reference, their hits are merged here */
+		cout << "Running OffTarget Analysis in " << OT.getShardCount() << " shards" << endl;
+		OT.runShards();
+	}
+	else
+	{
+		/* parse data needed for algorithm */
+		cout << "Loading data for algorithm" << endl;
+		OT.getAlgorithmData();
 
-	/* run the OffTarget algorithm */
-	cout << "Running OffTarget Analysis" << endl;
-	OT.run();
+		/* run the OffTarget algorithm */
+		cout << "Running OffTarget Analysis" << endl;
+		OT.run();
+	}
 
 	auto end = high_resolution_clock::now();
 	